@@ -0,0 +1,73 @@
+#include "aot.hpp"
+
+#include <bit>
+#include <cstring>
+
+
+// What the translator saw at addr: the ROM, and zeros after it, which it
+// compiled as 0000 no-ops wherever control could reach them
+static uint8_t romByte(const AotState &s, unsigned addr) {
+    size_t i = addr - PROGRAM_START;
+    return i < s.romSize ? s.rom[i] : 0;
+}
+
+
+static bool slotMatchesRom(const Chip8 &c, const AotState &s, unsigned slot) {
+    for (unsigned addr = 2 * slot; addr < 2 * slot + 2; ++addr) {
+        if (addr >= PROGRAM_START && c.memory[addr] != romByte(s, addr))
+            return false;
+    }
+    return true;
+}
+
+
+// Starts a run from the machine's current memory. Compiled code is only
+// trusted where memory still holds the image it was generated from. The
+// machine's write bitmap is left alone: writes other caches have not
+// consumed yet stay pending, and aotSync checks them against the ROM.
+void aotReset(Chip8 &c, AotState &s, const uint8_t *rom, size_t size) {
+    std::memset(s.stale, 0, sizeof(s.stale));
+    s.anyStale = false;
+    s.rom = rom;
+    s.romSize = size;
+
+    for (unsigned addr = PROGRAM_START; addr < MEMORY_SIZE; ++addr) {
+        if (c.memory[addr] != romByte(s, addr)) {
+            unsigned slot = addr / 2;
+            s.stale[slot / 64] |= uint64_t{1} << (slot % 64);
+            s.anyStale = true;
+        }
+    }
+}
+
+
+// Takes the writes since the last sync. A written code slot is stale while
+// its bytes differ from the ROM, so rewriting the same code (or the
+// loader's initial marks) costs nothing.
+void aotSync(Chip8 &c, AotState &s, const uint64_t *codeSlots) {
+    uint64_t dirty[NUM_WRITE_WORDS];
+    if (!takeWrites(c, codeSlots, dirty))
+        return;
+    bool any = false;
+    for (int w = 0; w < NUM_WRITE_WORDS; ++w) {
+        for (uint64_t bits = dirty[w] & codeSlots[w]; bits; bits &= bits - 1) {
+            unsigned slot = static_cast<unsigned>(w * 64 + std::countr_zero(bits));
+            uint64_t bit = uint64_t{1} << (slot % 64);
+            if (slotMatchesRom(c, s, slot))
+                s.stale[w] &= ~bit;
+            else
+                s.stale[w] |= bit;
+        }
+        any |= s.stale[w] != 0;
+    }
+    s.anyStale = any;
+}
+
+
+void aotInterpret(Chip8 &c, AotState &s, const uint64_t *codeSlots) {
+    Instr d = decode(readOpcode(c, c.pc));
+    c.opcode = d.opcode;
+    executeInstr(c, d);
+    if (anyWritten(c))
+        aotSync(c, s, codeSlots);
+}
@@ -0,0 +1,48 @@
+#ifndef AOT_HPP
+#define AOT_HPP
+
+#include "cpu.hpp"
+#include "decode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Runtime support for translation units emitted by chip8_aot. Each one
+// compiles the blocks discovered in a single ROM into functions and
+// defines resetAot/runAot below; anything the translator could not prove
+// static (BNNN targets, code the ROM overwrites, a different ROM in
+// memory) runs on the interpreter instead.
+
+struct AotState {
+    uint64_t stale[NUM_WRITE_WORDS];   // compiled slots no longer matching the ROM
+    bool anyStale;
+    const uint8_t *rom;                // what the compiled code was generated from
+    size_t romSize;
+};
+
+// Per-ROM entry points, defined by the generated file
+void resetAot(Chip8 &c, AotState &s);
+uint32_t runAot(Chip8 &c, AotState &s, uint32_t budget);
+
+// Shared by every generated file
+void aotReset(Chip8 &c, AotState &s, const uint8_t *rom, size_t size);
+void aotSync(Chip8 &c, AotState &s, const uint64_t *codeSlots);
+void aotInterpret(Chip8 &c, AotState &s, const uint64_t *codeSlots);
+
+// True when the block at start (len instructions) may run: it fits in the
+// remaining budget and none of its code has been overwritten. Charges it.
+inline bool aotEnter(const AotState &s, uint32_t &done, uint32_t budget,
+                     uint16_t start, uint16_t len) {
+    if (len > budget - done)
+        return false;
+    if (s.anyStale) {
+        for (unsigned slot = start / 2u; slot < start / 2u + len; ++slot)
+            if (slotWritten(s.stale, slot))
+                return false;
+    }
+    done += len;
+    return true;
+}
+
+
+#endif
@@ -0,0 +1,90 @@
+#include "cpu.hpp"
+#include "aot.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+
+// Driver for a ROM translated by chip8_aot. Runs the compiled ROM for a
+// number of 60 Hz frames; with --verify it steps emulateCycle alongside
+// and stops at the first frame where the two machines differ.
+//
+//   ./rom_aot rom.ch8 [--frames N] [--cycles N] [--verify]
+
+static void tickTimers(Chip8 &c) {
+    if (c.delayTimer > 0) --c.delayTimer;
+    if (c.soundTimer > 0) --c.soundTimer;
+}
+
+static bool sameState(const Chip8 &a, const Chip8 &b) {
+    return std::memcmp(a.memory, b.memory, sizeof(a.memory)) == 0 &&
+           std::memcmp(a.V, b.V, sizeof(a.V)) == 0 &&
+           a.I == b.I && a.pc == b.pc && a.sp == b.sp &&
+           std::memcmp(a.stack, b.stack, sizeof(a.stack)) == 0 &&
+           a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer &&
+           std::memcmp(a.gfx, b.gfx, sizeof(a.gfx)) == 0 &&
+           a.opcode == b.opcode;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " rom.ch8 [--frames N] [--cycles N] [--verify]\n";
+        return 1;
+    }
+
+    long frames = 1'000'000;
+    uint32_t cyclesPerFrame = 8;
+    bool verify = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+            frames = std::atol(argv[++i]);
+        else if (arg == "--cycles" && i + 1 < argc)
+            cyclesPerFrame = static_cast<uint32_t>(std::atol(argv[++i]));
+        else if (arg == "--verify")
+            verify = true;
+    }
+
+    Chip8 chip8, reference;
+    initialise(chip8);
+    if (!loadROM(argv[1], chip8))
+        return 1;
+    reference = chip8;
+
+    static AotState state;
+    resetAot(chip8, state);
+
+    auto start = std::chrono::steady_clock::now();
+    for (long f = 0; f < frames; ++f) {
+        // Same random stream for both machines
+        unsigned seed = static_cast<unsigned>(f);
+        if (verify)
+            seedRandom(seed);
+        runAot(chip8, state, cyclesPerFrame);
+        tickTimers(chip8);
+
+        if (verify) {
+            seedRandom(seed);
+            for (uint32_t i = 0; i < cyclesPerFrame; ++i)
+                emulateCycle(reference);
+            tickTimers(reference);
+            if (!sameState(chip8, reference)) {
+                std::cerr << "Mismatch at frame " << f << ": pc " << std::hex
+                          << chip8.pc << " vs " << reference.pc << std::dec << "\n";
+                return 2;
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double secs = std::chrono::duration<double>(end - start).count();
+    std::cout << frames << " frames in " << secs << " s ("
+              << frames * cyclesPerFrame / secs / 1e6 << " MIPS)"
+              << (verify ? ", identical to emulateCycle" : "") << "\n";
+    return 0;
+}
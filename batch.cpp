@@ -0,0 +1,869 @@
+#include "batch.hpp"
+#include "decode.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CHIP8_BATCH_X86 1
+#endif
+
+
+// Lockstep batch interpreter. The vector kernels work on 32 lanes per
+// iteration: byte fields (V, timers) as one register, 16-bit fields (pc,
+// I, opcode) as two. A masked op computes the result for every lane and
+// blends it in only where the lane's opcode matches. Like the expansion
+// kernels, the AVX2 code is compiled with a target attribute and chosen at
+// run time, so the rest of the program needs no -mavx2.
+
+// Opcode groups smaller than stride / MIN_GROUP_DIVISOR lanes are cheaper
+// to run lane by lane than as a full-width masked pass.
+constexpr int MIN_GROUP_DIVISOR = 64;
+constexpr uint8_t NO_GROUP = MAX_GROUPS;
+
+// The divergent fetch gathers 4 bytes per lane, so memory has room for
+// the last lane's 3 extra
+constexpr size_t GATHER_SLACK = 3;
+
+
+static bool haveAVX2() {
+#if defined(CHIP8_BATCH_X86)
+    static const bool avx2 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+
+// Instructions with a vector kernel: those that only touch registers,
+// timers and the keypad, plus stack, memory and sprite accesses, which run
+// as vector ops on each block of 32 lanes whose sp or I agree.
+static constexpr bool vectorizable(Op op) {
+    switch (op) {
+        case Op::NOP:
+        case Op::JP:
+        case Op::JP_V0:
+        case Op::SE_VX_NN:
+        case Op::SNE_VX_NN:
+        case Op::SE_VX_VY:
+        case Op::SNE_VX_VY:
+        case Op::LD_VX_NN:
+        case Op::ADD_VX_NN:
+        case Op::LD_VX_VY:
+        case Op::OR:
+        case Op::AND:
+        case Op::XOR:
+        case Op::ADD_VX_VY:
+        case Op::SUB:
+        case Op::SHR:
+        case Op::SUBN:
+        case Op::SHL:
+        case Op::LD_I:
+        case Op::ADD_I_VX:
+        case Op::LD_F_VX:
+        case Op::SKP:
+        case Op::SKNP:
+        case Op::CALL:
+        case Op::RET:
+        case Op::LD_I_VX:
+        case Op::LD_VX_I:
+        case Op::DRW:
+        case Op::LD_VX_DT:
+        case Op::LD_DT_VX:
+        case Op::LD_ST_VX:
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+void setLane(Batch &b, int lane, const Chip8 &c) {
+    const int S = b.stride;
+    for (int a = 0; a < MEMORY_SIZE; ++a)
+        b.memory[a * S + lane] = c.memory[a];
+    for (int r = 0; r < NUM_REGISTERS; ++r)
+        b.V[r * S + lane] = c.V[r];
+    for (int s = 0; s < STACK_SIZE; ++s)
+        b.stack[s * S + lane] = c.stack[s];
+    for (int y = 0; y < SCREEN_HEIGHT; ++y)
+        b.gfx[lane * SCREEN_HEIGHT + y] = c.gfx[y];
+
+    uint16_t keys = 0;
+    for (int k = 0; k < NUM_KEYS; ++k)
+        keys |= static_cast<uint16_t>(c.keys[k]) << k;
+    b.keys[lane] = keys;
+
+    b.I[lane] = c.I;
+    b.pc[lane] = c.pc;
+    b.opcode[lane] = c.opcode;
+    b.sp[lane] = c.sp;
+    b.delayTimer[lane] = c.delayTimer;
+    b.soundTimer[lane] = c.soundTimer;
+    b.dirty_rows[lane] = c.dirty_rows;
+    b.draw_flag[lane] = c.draw_flag;
+    b.key_wait[lane] = c.key_wait;
+}
+
+
+void getLane(const Batch &b, int lane, Chip8 &c) {
+    const int S = b.stride;
+    for (int a = 0; a < MEMORY_SIZE; ++a)
+        c.memory[a] = b.memory[a * S + lane];
+    for (int r = 0; r < NUM_REGISTERS; ++r)
+        c.V[r] = b.V[r * S + lane];
+    for (int s = 0; s < STACK_SIZE; ++s)
+        c.stack[s] = b.stack[s * S + lane];
+    for (int y = 0; y < SCREEN_HEIGHT; ++y)
+        c.gfx[y] = b.gfx[lane * SCREEN_HEIGHT + y];
+    for (int k = 0; k < NUM_KEYS; ++k)
+        c.keys[k] = (b.keys[lane] >> k) & 1;
+
+    c.I = b.I[lane];
+    c.pc = b.pc[lane];
+    c.opcode = b.opcode[lane];
+    c.sp = b.sp[lane];
+    c.delayTimer = b.delayTimer[lane];
+    c.soundTimer = b.soundTimer[lane];
+    c.dirty_rows = b.dirty_rows[lane];
+    c.draw_flag = b.draw_flag[lane];
+    c.key_wait = b.key_wait[lane];
+
+    // The batch has no decode caches to invalidate; a machine taken out
+    // of it starts with all of memory marked written
+    std::fill(std::begin(c.mem_dirty), std::end(c.mem_dirty), ~uint64_t{0});
+    c.mem_dirty_words = (NUM_WRITE_WORDS == 32) ? ~uint32_t{0} : (uint32_t{1} << NUM_WRITE_WORDS) - 1;
+}
+
+
+void resetBatch(Batch &b, int lanes, const Chip8 &image) {
+    b.lanes = lanes;
+    b.stride = (lanes + BATCH_LANE_ALIGN - 1) / BATCH_LANE_ALIGN * BATCH_LANE_ALIGN;
+    const size_t S = static_cast<size_t>(b.stride);
+
+    b.memory.assign(MEMORY_SIZE * S + GATHER_SLACK, 0);
+    b.V.assign(NUM_REGISTERS * S, 0);
+    b.I.assign(S, 0);
+    b.pc.assign(S, 0);
+    b.opcode.assign(S, 0);
+    b.stack.assign(STACK_SIZE * S, 0);
+    b.sp.assign(S, 0);
+    b.delayTimer.assign(S, 0);
+    b.soundTimer.assign(S, 0);
+    b.keys.assign(S, 0);
+    b.gfx.assign(SCREEN_HEIGHT * S, 0);
+    b.dirty_rows.assign(S, 0);
+    b.draw_flag.assign(S, 0);
+    b.key_wait.assign(S, 0);
+    b.stats = BatchStats{};
+    b.opcodeGroup.assign(0x10000, 0);
+    b.laneGroup.assign(S, NO_GROUP);
+    b.groups = 0;
+    b.cutoffLeft = 0;
+
+    // Padding lanes get the image too so vector passes over them stay
+    // harmless; they are never run lane by lane
+    for (int l = 0; l < b.stride; ++l)
+        setLane(b, l, image);
+}
+
+
+// DXYN for one lane: drawSprite on the strided layout
+static void drawLane(Batch &b, int l, unsigned x, unsigned y, unsigned n) {
+    const int S = b.stride;
+    uint8_t *V = &b.V[l];
+    uint64_t *gfx = &b.gfx[l * SCREEN_HEIGHT];
+    auto reg = [&](unsigned r) -> uint8_t & { return V[r * S]; };
+    auto spriteRow = [&](unsigned row) {
+        return b.memory[((b.I[l] + row) % MEMORY_SIZE) * S + l];
+    };
+
+    if (x != 0xF && y != 0xF) {
+        unsigned shift = reg(x) % SCREEN_WIDTH;
+        uint64_t hit = 0;
+        for (unsigned row = 0; row < n; ++row) {
+            uint64_t mask = std::rotr(uint64_t{spriteRow(row)} << 56, static_cast<int>(shift));
+            unsigned py = (reg(y) + row) % SCREEN_HEIGHT;
+            uint64_t &line = gfx[py];
+            hit |= line & mask;
+            line ^= mask;
+            b.dirty_rows[l] |= uint32_t{1} << py;
+        }
+        reg(0xF) = hit != 0;
+        return;
+    }
+
+    // VF as a coordinate: pixel by pixel, as drawSprite does
+    reg(0xF) = 0;
+    for (unsigned row = 0; row < n; ++row) {
+        uint8_t sprite = spriteRow(row);
+        for (int col = 0; col < 8; ++col) {
+            if (sprite & (0x80 >> col)) {
+                int px = (reg(x) + col) % SCREEN_WIDTH;
+                int py = (reg(y) + row) % SCREEN_HEIGHT;
+                uint64_t bit = uint64_t{1} << (SCREEN_WIDTH - 1 - px);
+                uint64_t &line = gfx[py];
+                if (line & bit)
+                    reg(0xF) = 1;
+                line ^= bit;
+                b.dirty_rows[l] |= uint32_t{1} << py;
+            }
+        }
+    }
+}
+
+
+// One instruction on one lane, case for case as emulateCycle. Memory,
+// stack and keypad indices wrap where emulateCycle would run off the end.
+static void executeLane(Batch &b, int l, const Instr &d) {
+    const int S = b.stride;
+    uint8_t *V = &b.V[l];
+    auto reg = [&](unsigned r) -> uint8_t & { return V[r * S]; };
+    auto mem = [&](unsigned addr) -> uint8_t & { return b.memory[(addr % MEMORY_SIZE) * S + l]; };
+    auto stackAt = [&](unsigned level) -> uint16_t & { return b.stack[(level % STACK_SIZE) * S + l]; };
+    const uint8_t x = d.x;
+    const uint8_t y = d.y;
+    uint16_t &pc = b.pc[l];
+    uint16_t &I = b.I[l];
+
+    switch (d.op) {
+        case Op::CLS:
+            std::fill_n(&b.gfx[l * SCREEN_HEIGHT], SCREEN_HEIGHT, uint64_t{0});
+            b.dirty_rows[l] = ~uint32_t{0};
+            b.draw_flag[l] = true;
+            pc += 2;
+            break;
+        case Op::RET:
+            pc = stackAt(--b.sp[l]);
+            break;
+        case Op::JP:
+            pc = d.nnn;
+            break;
+        case Op::CALL:
+            stackAt(b.sp[l]++) = pc + 2;
+            pc = d.nnn;
+            break;
+        case Op::SE_VX_NN:  pc += reg(x) == d.nn() ? 4 : 2; break;
+        case Op::SNE_VX_NN: pc += reg(x) != d.nn() ? 4 : 2; break;
+        case Op::SE_VX_VY:  pc += reg(x) == reg(y) ? 4 : 2; break;
+        case Op::SNE_VX_VY: pc += reg(x) != reg(y) ? 4 : 2; break;
+        case Op::LD_VX_NN:  reg(x) = d.nn(); pc += 2; break;
+        case Op::ADD_VX_NN: reg(x) += d.nn(); pc += 2; break;
+        case Op::LD_VX_VY:  reg(x) = reg(y); pc += 2; break;
+        case Op::OR:        reg(x) |= reg(y); pc += 2; break;
+        case Op::AND:       reg(x) &= reg(y); pc += 2; break;
+        case Op::XOR:       reg(x) ^= reg(y); pc += 2; break;
+        case Op::ADD_VX_VY: {
+            uint16_t sum = reg(x) + reg(y);
+            reg(0xF) = sum > 0xFF;
+            reg(x) = sum & 0xFF;
+            pc += 2;
+            break;
+        }
+        case Op::SUB:
+            reg(0xF) = reg(x) >= reg(y);
+            reg(x) -= reg(y);
+            pc += 2;
+            break;
+        case Op::SHR:
+            reg(0xF) = reg(x) & 0x01;
+            reg(x) >>= 1;
+            pc += 2;
+            break;
+        case Op::SUBN:
+            reg(0xF) = reg(y) >= reg(x);
+            reg(x) = reg(y) - reg(x);
+            pc += 2;
+            break;
+        case Op::SHL:
+            reg(0xF) = (reg(x) & 0x80) >> 7;
+            reg(x) <<= 1;
+            pc += 2;
+            break;
+        case Op::LD_I:
+            I = d.nnn;
+            pc += 2;
+            break;
+        case Op::JP_V0:
+            pc = d.nnn + reg(0);
+            break;
+        case Op::RND:
+            reg(x) = randomByte() & d.nn();
+            pc += 2;
+            break;
+        case Op::DRW:
+            drawLane(b, l, x, y, d.n);
+            b.draw_flag[l] = true;
+            pc += 2;
+            break;
+        case Op::SKP:  pc += (b.keys[l] >> (reg(x) % NUM_KEYS)) & 1 ? 4 : 2; break;
+        case Op::SKNP: pc += (b.keys[l] >> (reg(x) % NUM_KEYS)) & 1 ? 2 : 4; break;
+        case Op::LD_VX_DT:
+            reg(x) = b.delayTimer[l];
+            pc += 2;
+            break;
+        case Op::LD_VX_K:
+            if (b.keys[l]) {
+                reg(x) = static_cast<uint8_t>(std::countr_zero(b.keys[l]));
+                b.key_wait[l] = false;
+                pc += 2;
+            } else {
+                b.key_wait[l] = true;
+            }
+            break;
+        case Op::LD_DT_VX: b.delayTimer[l] = reg(x); pc += 2; break;
+        case Op::LD_ST_VX: b.soundTimer[l] = reg(x); pc += 2; break;
+        case Op::ADD_I_VX: I += reg(x); pc += 2; break;
+        case Op::LD_F_VX:  I = reg(x) * 5; pc += 2; break;
+        case Op::LD_B_VX:
+            mem(I) = reg(x) / 100;
+            mem(I + 1) = (reg(x) / 10) % 10;
+            mem(I + 2) = reg(x) % 10;
+            pc += 2;
+            break;
+        case Op::LD_I_VX:
+            for (unsigned i = 0; i <= x; ++i)
+                mem(I + i) = reg(i);
+            pc += 2;
+            break;
+        case Op::LD_VX_I:
+            for (unsigned i = 0; i <= x; ++i)
+                reg(i) = mem(I + i);
+            pc += 2;
+            break;
+        default:
+            pc += 2;
+            break;
+    }
+}
+
+
+static bool allEqualScalar(const uint16_t *v, int n) {
+    for (int i = 1; i < n; ++i)
+        if (v[i] != v[0])
+            return false;
+    return true;
+}
+
+
+static void fetchScalar(Batch &b, bool pcUniform) {
+    const int S = b.stride;
+    if (pcUniform) {
+        const uint8_t *hi = &b.memory[(b.pc[0] % MEMORY_SIZE) * S];
+        const uint8_t *lo = &b.memory[((b.pc[0] + 1) % MEMORY_SIZE) * S];
+        for (int l = 0; l < b.lanes; ++l)
+            b.opcode[l] = static_cast<uint16_t>((hi[l] << 8) | lo[l]);
+        return;
+    }
+    for (int l = 0; l < b.lanes; ++l) {
+        unsigned pc = b.pc[l];
+        b.opcode[l] = static_cast<uint16_t>((b.memory[(pc % MEMORY_SIZE) * S + l] << 8) |
+                                            b.memory[((pc + 1) % MEMORY_SIZE) * S + l]);
+    }
+}
+
+
+static void tickScalar(Batch &b) {
+    for (int l = 0; l < b.stride; ++l) {
+        if (b.delayTimer[l] > 0) --b.delayTimer[l];
+        if (b.soundTimer[l] > 0) --b.soundTimer[l];
+    }
+}
+
+
+#if defined(CHIP8_BATCH_X86)
+
+__attribute__((target("avx2")))
+static inline __m256i load256(const void *p) {
+    return _mm256_loadu_si256(static_cast<const __m256i *>(p));
+}
+
+__attribute__((target("avx2")))
+static inline void store256(void *p, __m256i v) {
+    _mm256_storeu_si256(static_cast<__m256i *>(p), v);
+}
+
+// Zero-extends 32 bytes to two registers of 16 lanes each
+__attribute__((target("avx2")))
+static inline void widen(__m256i v, __m256i &lo, __m256i &hi) {
+    lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+    hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+}
+
+
+__attribute__((target("avx2")))
+static bool allEqualAVX2(const uint16_t *v, int n) {
+    const __m256i first = _mm256_set1_epi16(static_cast<short>(v[0]));
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(load256(v + i), first)) != -1)
+            return false;
+    for (; i < n; ++i)
+        if (v[i] != v[0])
+            return false;
+    return true;
+}
+
+
+// Every lane at the same pc: two contiguous rows of memory hold the opcode
+// bytes for all lanes
+__attribute__((target("avx2")))
+static void fetchUniformAVX2(Batch &b) {
+    const int S = b.stride;
+    const uint8_t *hi = &b.memory[(b.pc[0] % MEMORY_SIZE) * S];
+    const uint8_t *lo = &b.memory[((b.pc[0] + 1) % MEMORY_SIZE) * S];
+    for (int l = 0; l < S; l += 32) {
+        __m256i hLo, hHi, lLo, lHi;
+        widen(load256(hi + l), hLo, hHi);
+        widen(load256(lo + l), lLo, lHi);
+        store256(&b.opcode[l], _mm256_or_si256(_mm256_slli_epi16(hLo, 8), lLo));
+        store256(&b.opcode[l + 16], _mm256_or_si256(_mm256_slli_epi16(hHi, 8), lHi));
+    }
+}
+
+
+// Lanes at different pcs: gathers each lane's opcode bytes from its own
+// two rows, 8 lanes at a time
+__attribute__((target("avx2")))
+static void fetchGatherAVX2(Batch &b) {
+    const int S = b.stride;
+    const int *memory = reinterpret_cast<const int *>(b.memory.data());
+    const __m256i laneOffset = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i addrMask = _mm256_set1_epi32(MEMORY_SIZE - 1);
+    const __m256i stride = _mm256_set1_epi32(S);
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    for (int l = 0; l < S; l += 8) {
+        __m256i pc = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&b.pc[l])));
+        __m256i lane = _mm256_add_epi32(_mm256_set1_epi32(l), laneOffset);
+        __m256i hiAt = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(pc, addrMask), stride), lane);
+        __m256i loAt = _mm256_add_epi32(
+            _mm256_mullo_epi32(_mm256_and_si256(_mm256_add_epi32(pc, _mm256_set1_epi32(1)), addrMask), stride), lane);
+        __m256i hi = _mm256_and_si256(_mm256_i32gather_epi32(memory, hiAt, 1), byteMask);
+        __m256i lo = _mm256_and_si256(_mm256_i32gather_epi32(memory, loAt, 1), byteMask);
+        __m256i op = _mm256_or_si256(_mm256_slli_epi32(hi, 8), lo);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(op, op), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&b.opcode[l]), _mm256_castsi256_si128(packed));
+    }
+}
+
+
+// Bit i set for each real lane among l .. l + 31, padding excluded
+static inline uint32_t liveLanes(const Batch &b, int l) {
+    int n = b.lanes - l;
+    return n >= 32 ? ~uint32_t{0} : (uint32_t{1} << n) - 1;
+}
+
+// Whether the lanes in active all hold the same value
+static bool sameByte(const uint8_t *v, uint32_t active) {
+    uint8_t first = v[std::countr_zero(active)];
+    for (uint32_t a = active; a; a &= a - 1)
+        if (v[std::countr_zero(a)] != first)
+            return false;
+    return true;
+}
+
+static bool sameWord(const uint16_t *v, uint32_t active) {
+    uint16_t first = v[std::countr_zero(active)];
+    for (uint32_t a = active; a; a &= a - 1)
+        if (v[std::countr_zero(a)] != first)
+            return false;
+    return true;
+}
+
+static void executeLanes(Batch &b, int l, uint32_t active, const Instr &d) {
+    for (uint32_t a = active; a; a &= a - 1)
+        executeLane(b, l + std::countr_zero(a), d);
+}
+
+
+// DXYN on the active lanes of a block that share I: the sprite rows are
+// loaded once for all 32 lanes, then each lane draws from them
+__attribute__((target("avx2")))
+static void drawBlockAVX2(Batch &b, int l, uint32_t active, const Instr &d, __m256i x, __m256i y) {
+    const int S = b.stride;
+    const unsigned I = b.I[l + std::countr_zero(active)];
+    alignas(32) uint8_t sprite[16][32];
+    alignas(32) uint8_t xs[32];
+    alignas(32) uint8_t ys[32];
+    for (unsigned row = 0; row < d.n; ++row)
+        store256(sprite[row], load256(&b.memory[((I + row) % MEMORY_SIZE) * S + l]));
+    store256(xs, x);
+    store256(ys, y);
+
+    for (uint32_t a = active; a; a &= a - 1) {
+        int j = std::countr_zero(a);
+        uint64_t *gfx = &b.gfx[(l + j) * SCREEN_HEIGHT];
+        unsigned shift = xs[j] % SCREEN_WIDTH;
+        uint64_t hit = 0;
+        uint32_t dirty = 0;
+        for (unsigned row = 0; row < d.n; ++row) {
+            uint64_t mask = std::rotr(uint64_t{sprite[row][j]} << 56, static_cast<int>(shift));
+            unsigned py = (ys[j] + row) % SCREEN_HEIGHT;
+            hit |= gfx[py] & mask;
+            gfx[py] ^= mask;
+            dirty |= uint32_t{1} << py;
+        }
+        b.V[0xF * S + l + j] = hit != 0;
+        b.dirty_rows[l + j] |= dirty;
+        b.draw_flag[l + j] = true;
+    }
+}
+
+
+// Runs d on every lane, or with masked only on lanes whose opcode is d's.
+// VF is stored before Vx so that for x = F the result wins over the flag,
+// as in emulateCycle.
+template <Op O>
+__attribute__((target("avx2")))
+static void executeAVX2(Batch &b, const Instr &d, bool masked) {
+    const int S = b.stride;
+    uint8_t *vx = &b.V[d.x * S];
+    uint8_t *vy = &b.V[d.y * S];
+    uint8_t *vf = &b.V[0xF * S];
+    uint8_t *v0 = &b.V[0];
+    const __m256i opcode = _mm256_set1_epi16(static_cast<short>(d.opcode));
+    const __m256i ones = _mm256_set1_epi8(-1);
+    const __m256i one8 = _mm256_set1_epi8(1);
+    const __m256i nn8 = _mm256_set1_epi8(static_cast<char>(d.nn()));
+    const __m256i nnn16 = _mm256_set1_epi16(static_cast<short>(d.nnn));
+    const __m256i two16 = _mm256_set1_epi16(2);
+    const __m256i keyBits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                             1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    constexpr bool writesX = O == Op::LD_VX_NN || O == Op::ADD_VX_NN || O == Op::LD_VX_VY ||
+                             O == Op::OR || O == Op::AND || O == Op::XOR || O == Op::ADD_VX_VY ||
+                             O == Op::SUB || O == Op::SHR || O == Op::SUBN || O == Op::SHL ||
+                             O == Op::LD_VX_DT;
+    constexpr bool writesF = O == Op::ADD_VX_VY || O == Op::SUB || O == Op::SHR ||
+                             O == Op::SUBN || O == Op::SHL;
+
+    for (int l = 0; l < S; l += 32) {
+        __m256i m16lo = ones, m16hi = ones, m8 = ones;
+        if (masked) {
+            m16lo = _mm256_cmpeq_epi16(load256(&b.opcode[l]), opcode);
+            m16hi = _mm256_cmpeq_epi16(load256(&b.opcode[l + 16]), opcode);
+            m8 = _mm256_permute4x64_epi64(_mm256_packs_epi16(m16lo, m16hi), 0xD8);
+        }
+        uint32_t active = static_cast<uint32_t>(_mm256_movemask_epi8(m8)) & liveLanes(b, l);
+        if (active == 0)
+            continue;
+
+        // Stack and memory rows are only shared by lanes at the same sp or
+        // I; a block where they differ runs lane by lane
+        if constexpr (O == Op::CALL || O == Op::RET) {
+            if (!sameByte(&b.sp[l], active)) {
+                executeLanes(b, l, active, d);
+                continue;
+            }
+        } else if constexpr (O == Op::LD_I_VX || O == Op::LD_VX_I) {
+            if (!sameWord(&b.I[l], active)) {
+                executeLanes(b, l, active, d);
+                continue;
+            }
+        } else if constexpr (O == Op::DRW) {
+            if (d.x == 0xF || d.y == 0xF || !sameWord(&b.I[l], active)) {
+                executeLanes(b, l, active, d);
+                continue;
+            }
+        }
+
+        __m256i x = load256(vx + l);
+        __m256i y = load256(vy + l);
+        __m256i nx = x, nf = x, skip = _mm256_setzero_si256();
+        __m256i pcLo = load256(&b.pc[l]);
+        __m256i pcHi = load256(&b.pc[l + 16]);
+        __m256i newLo, newHi;
+
+        if constexpr (O == Op::SE_VX_NN) {
+            skip = _mm256_cmpeq_epi8(x, nn8);
+        } else if constexpr (O == Op::SNE_VX_NN) {
+            skip = _mm256_xor_si256(_mm256_cmpeq_epi8(x, nn8), ones);
+        } else if constexpr (O == Op::SE_VX_VY) {
+            skip = _mm256_cmpeq_epi8(x, y);
+        } else if constexpr (O == Op::SNE_VX_VY) {
+            skip = _mm256_xor_si256(_mm256_cmpeq_epi8(x, y), ones);
+        } else if constexpr (O == Op::LD_VX_NN) {
+            nx = nn8;
+        } else if constexpr (O == Op::ADD_VX_NN) {
+            nx = _mm256_add_epi8(x, nn8);
+        } else if constexpr (O == Op::LD_VX_VY) {
+            nx = y;
+        } else if constexpr (O == Op::OR) {
+            nx = _mm256_or_si256(x, y);
+        } else if constexpr (O == Op::AND) {
+            nx = _mm256_and_si256(x, y);
+        } else if constexpr (O == Op::XOR) {
+            nx = _mm256_xor_si256(x, y);
+        } else if constexpr (O == Op::ADD_VX_VY) {
+            nx = _mm256_add_epi8(x, y);
+            __m256i noCarry = _mm256_cmpeq_epi8(_mm256_max_epu8(nx, x), nx);
+            nf = _mm256_andnot_si256(noCarry, one8);
+        } else if constexpr (O == Op::SUB || O == Op::SUBN || O == Op::SHR || O == Op::SHL) {
+            // emulateCycle sets VF first and then reads Vx and Vy again, so
+            // an operand that is VF sees the flag
+            if constexpr (O == Op::SUB)
+                nf = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, y), x), one8);
+            else if constexpr (O == Op::SUBN)
+                nf = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, y), y), one8);
+            else if constexpr (O == Op::SHR)
+                nf = _mm256_and_si256(x, one8);
+            else
+                nf = _mm256_and_si256(_mm256_srli_epi16(x, 7), one8);
+            __m256i a = d.x == 0xF ? nf : x;
+            __m256i c = d.y == 0xF ? nf : y;
+            if constexpr (O == Op::SUB)
+                nx = _mm256_sub_epi8(a, c);
+            else if constexpr (O == Op::SUBN)
+                nx = _mm256_sub_epi8(c, a);
+            else if constexpr (O == Op::SHR)
+                nx = _mm256_and_si256(_mm256_srli_epi16(a, 1), _mm256_set1_epi8(0x7F));
+            else
+                nx = _mm256_add_epi8(a, a);
+        } else if constexpr (O == Op::SKP || O == Op::SKNP) {
+            // Key Vx is bit Vx & 7 of the low or high byte of the mask
+            __m256i key = _mm256_and_si256(x, _mm256_set1_epi8(0x0F));
+            __m256i kLo = load256(&b.keys[l]);
+            __m256i kHi = load256(&b.keys[l + 16]);
+            __m256i byteMask = _mm256_set1_epi16(0x00FF);
+            __m256i low = _mm256_permute4x64_epi64(
+                _mm256_packus_epi16(_mm256_and_si256(kLo, byteMask), _mm256_and_si256(kHi, byteMask)), 0xD8);
+            __m256i high = _mm256_permute4x64_epi64(
+                _mm256_packus_epi16(_mm256_srli_epi16(kLo, 8), _mm256_srli_epi16(kHi, 8)), 0xD8);
+            __m256i held = _mm256_blendv_epi8(high, low, _mm256_cmpgt_epi8(_mm256_set1_epi8(8), key));
+            __m256i bit = _mm256_shuffle_epi8(keyBits, key);
+            __m256i pressed = _mm256_cmpeq_epi8(_mm256_and_si256(held, bit), bit);
+            skip = O == Op::SKP ? pressed : _mm256_xor_si256(pressed, ones);
+        } else if constexpr (O == Op::CALL) {
+            unsigned sp = b.sp[l + std::countr_zero(active)];
+            uint16_t *top = &b.stack[(sp % STACK_SIZE) * S + l];
+            store256(top, _mm256_blendv_epi8(load256(top), _mm256_add_epi16(pcLo, two16), m16lo));
+            store256(top + 16, _mm256_blendv_epi8(load256(top + 16), _mm256_add_epi16(pcHi, two16), m16hi));
+            store256(&b.sp[l], _mm256_blendv_epi8(load256(&b.sp[l]),
+                                                  _mm256_set1_epi8(static_cast<char>(sp + 1)), m8));
+        } else if constexpr (O == Op::RET) {
+            unsigned sp = static_cast<uint8_t>(b.sp[l + std::countr_zero(active)] - 1);
+            const uint16_t *top = &b.stack[(sp % STACK_SIZE) * S + l];
+            newLo = load256(top);
+            newHi = load256(top + 16);
+            store256(&b.sp[l], _mm256_blendv_epi8(load256(&b.sp[l]),
+                                                  _mm256_set1_epi8(static_cast<char>(sp)), m8));
+        } else if constexpr (O == Op::LD_I_VX || O == Op::LD_VX_I) {
+            unsigned I = b.I[l + std::countr_zero(active)];
+            for (unsigned i = 0; i <= d.x; ++i) {
+                uint8_t *reg = &b.V[i * S + l];
+                uint8_t *mem = &b.memory[((I + i) % MEMORY_SIZE) * S + l];
+                if constexpr (O == Op::LD_I_VX)
+                    store256(mem, _mm256_blendv_epi8(load256(mem), load256(reg), m8));
+                else
+                    store256(reg, _mm256_blendv_epi8(load256(reg), load256(mem), m8));
+            }
+        } else if constexpr (O == Op::DRW) {
+            drawBlockAVX2(b, l, active, d, x, y);
+        } else if constexpr (O == Op::LD_VX_DT) {
+            nx = load256(&b.delayTimer[l]);
+        } else if constexpr (O == Op::LD_DT_VX) {
+            store256(&b.delayTimer[l], _mm256_blendv_epi8(load256(&b.delayTimer[l]), x, m8));
+        } else if constexpr (O == Op::LD_ST_VX) {
+            store256(&b.soundTimer[l], _mm256_blendv_epi8(load256(&b.soundTimer[l]), x, m8));
+        } else if constexpr (O == Op::LD_I || O == Op::ADD_I_VX || O == Op::LD_F_VX) {
+            __m256i xLo, xHi, iLo, iHi;
+            widen(x, xLo, xHi);
+            if constexpr (O == Op::LD_I) {
+                iLo = iHi = nnn16;
+            } else if constexpr (O == Op::ADD_I_VX) {
+                iLo = _mm256_add_epi16(load256(&b.I[l]), xLo);
+                iHi = _mm256_add_epi16(load256(&b.I[l + 16]), xHi);
+            } else {
+                iLo = _mm256_mullo_epi16(xLo, _mm256_set1_epi16(5));
+                iHi = _mm256_mullo_epi16(xHi, _mm256_set1_epi16(5));
+            }
+            store256(&b.I[l], _mm256_blendv_epi8(load256(&b.I[l]), iLo, m16lo));
+            store256(&b.I[l + 16], _mm256_blendv_epi8(load256(&b.I[l + 16]), iHi, m16hi));
+        }
+
+        if constexpr (writesF)
+            store256(vf + l, _mm256_blendv_epi8(load256(vf + l), nf, m8));
+        if constexpr (writesX)
+            store256(vx + l, _mm256_blendv_epi8(x, nx, m8));
+
+        if constexpr (O == Op::JP || O == Op::CALL) {
+            newLo = newHi = nnn16;
+        } else if constexpr (O == Op::JP_V0) {
+            __m256i zLo, zHi;
+            widen(load256(v0 + l), zLo, zHi);
+            newLo = _mm256_add_epi16(nnn16, zLo);
+            newHi = _mm256_add_epi16(nnn16, zHi);
+        } else if constexpr (O != Op::RET) {
+            // 2, or 4 where the lane skips
+            __m256i sLo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(skip));
+            __m256i sHi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(skip, 1));
+            newLo = _mm256_add_epi16(pcLo, _mm256_add_epi16(two16, _mm256_and_si256(sLo, two16)));
+            newHi = _mm256_add_epi16(pcHi, _mm256_add_epi16(two16, _mm256_and_si256(sHi, two16)));
+        }
+        store256(&b.pc[l], _mm256_blendv_epi8(pcLo, newLo, m16lo));
+        store256(&b.pc[l + 16], _mm256_blendv_epi8(pcHi, newHi, m16hi));
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void tickAVX2(Batch &b) {
+    const __m256i one = _mm256_set1_epi8(1);
+    for (int l = 0; l < b.stride; l += 32) {
+        store256(&b.delayTimer[l], _mm256_subs_epu8(load256(&b.delayTimer[l]), one));
+        store256(&b.soundTimer[l], _mm256_subs_epu8(load256(&b.soundTimer[l]), one));
+    }
+}
+
+#endif
+
+
+static bool useAVX2(const Batch &b) {
+    return b.simd && haveAVX2();
+}
+
+
+static bool allEqual(const Batch &b, const uint16_t *v, int n) {
+#if defined(CHIP8_BATCH_X86)
+    if (useAVX2(b))
+        return allEqualAVX2(v, n);
+#endif
+    (void)b;
+    return allEqualScalar(v, n);
+}
+
+
+static void executeVector(Batch &b, const Instr &d, bool masked) {
+#if defined(CHIP8_BATCH_X86)
+    switch (d.op) {
+#define CHIP8_OP_CASE(name)                                 \
+        case Op::name:                                      \
+            if constexpr (vectorizable(Op::name))           \
+                executeAVX2<Op::name>(b, d, masked);        \
+            break;
+        CHIP8_OPS(CHIP8_OP_CASE)
+#undef CHIP8_OP_CASE
+        default: break;
+    }
+#else
+    (void)b; (void)d; (void)masked;
+#endif
+}
+
+
+// Numbers the distinct opcodes of a divergent step. Batch::opcodeGroup
+// maps an opcode to (stamp << 8) | group, so entries from earlier steps are
+// stale without clearing the table.
+static uint8_t findGroup(Batch &b, uint32_t stamp, uint16_t opcode) {
+    uint32_t &entry = b.opcodeGroup[opcode];
+    if ((entry >> 8) == stamp)
+        return static_cast<uint8_t>(entry);
+    if (b.groups == MAX_GROUPS)
+        return NO_GROUP;
+    uint8_t g = static_cast<uint8_t>(b.groups++);
+    b.groupOpcode[g] = opcode;
+    b.groupCount[g] = 0;
+    entry = (stamp << 8) | g;
+    return g;
+}
+
+
+static void step(Batch &b) {
+    ++b.stats.steps;
+
+    bool pcUniform = allEqual(b, b.pc.data(), b.lanes);
+#if defined(CHIP8_BATCH_X86)
+    if (useAVX2(b)) {
+        if (pcUniform)
+            fetchUniformAVX2(b);
+        else
+            fetchGatherAVX2(b);
+    } else
+#endif
+        fetchScalar(b, pcUniform);
+
+    if (pcUniform && allEqual(b, b.opcode.data(), b.lanes)) {
+        Instr d = decode(b.opcode[0]);
+        if (useAVX2(b) && vectorizable(d.op)) {
+            executeVector(b, d, false);
+            ++b.stats.uniformSteps;
+            return;
+        }
+        for (int l = 0; l < b.lanes; ++l)
+            executeLane(b, l, d);
+        b.stats.scalarLaneOps += b.lanes;
+        return;
+    }
+
+    // Divergent: masked vector passes for the big groups, then every other
+    // lane in ascending order. Right after a step where that left almost
+    // every lane scalar, the regrouping would not pay for itself either.
+    if (!useAVX2(b) || b.cutoffLeft > 0) {
+        if (b.cutoffLeft > 0) {
+            --b.cutoffLeft;
+            ++b.stats.cutoffSteps;
+        }
+        for (int l = 0; l < b.lanes; ++l)
+            executeLane(b, l, decode(b.opcode[l]));
+        b.stats.scalarLaneOps += b.lanes;
+        return;
+    }
+
+    uint32_t stamp = static_cast<uint32_t>(b.stats.steps % 0xFFFFFF) + 1;
+    if (stamp == 1)
+        std::fill(b.opcodeGroup.begin(), b.opcodeGroup.end(), 0);
+    b.groups = 0;
+    for (int l = 0; l < b.lanes; ++l) {
+        uint8_t g = findGroup(b, stamp, b.opcode[l]);
+        b.laneGroup[l] = g;
+        if (g != NO_GROUP)
+            ++b.groupCount[g];
+    }
+
+    bool vector[MAX_GROUPS + 1] = {};
+    uint32_t vectorLanes = 0;
+    for (int g = 0; g < b.groups; ++g) {
+        if (b.groupCount[g] * MIN_GROUP_DIVISOR < static_cast<uint32_t>(b.stride))
+            continue;
+        Instr d = decode(b.groupOpcode[g]);
+        if (!vectorizable(d.op))
+            continue;
+        executeVector(b, d, true);
+        vector[g] = true;
+        vectorLanes += b.groupCount[g];
+        ++b.stats.vectorGroups;
+    }
+    if (vectorLanes * MIN_VECTOR_SHARE_DIVISOR < static_cast<uint32_t>(b.lanes))
+        b.cutoffLeft = DIVERGENT_RUN;
+
+    for (int l = 0; l < b.lanes; ++l) {
+        if (vector[b.laneGroup[l]])
+            continue;
+        executeLane(b, l, decode(b.opcode[l]));
+        ++b.stats.scalarLaneOps;
+    }
+}
+
+
+void runBatch(Batch &b, uint32_t steps) {
+    for (uint32_t i = 0; i < steps; ++i)
+        step(b);
+}
+
+
+void tickBatchTimers(Batch &b) {
+#if defined(CHIP8_BATCH_X86)
+    if (useAVX2(b)) {
+        tickAVX2(b);
+        return;
+    }
+#endif
+    tickScalar(b);
+}
@@ -0,0 +1,90 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "cpu.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Lanes are stored in groups of this many, one AVX2 register of bytes.
+constexpr int BATCH_LANE_ALIGN = 32;
+
+// Distinct opcodes tracked in a divergent step; lanes beyond run scalar.
+constexpr int MAX_GROUPS = 255;
+
+// A divergent step whose vector groups cover fewer than lanes /
+// MIN_VECTOR_SHARE_DIVISOR lanes skips regrouping for the next
+// DIVERGENT_RUN divergent steps and runs them lane by lane.
+constexpr int MIN_VECTOR_SHARE_DIVISOR = 20;
+constexpr uint32_t DIVERGENT_RUN = 16;
+
+struct BatchStats {
+    uint64_t steps = 0;
+    uint64_t uniformSteps = 0;     // every lane ran the same opcode as one vector op
+    uint64_t vectorGroups = 0;     // masked vector ops over lanes sharing an opcode
+    uint64_t scalarLaneOps = 0;    // instructions run one lane at a time
+    uint64_t cutoffSteps = 0;      // divergent steps run lane by lane without regrouping
+};
+
+// Many Chip8 machines stepped in lockstep, one instruction per lane per
+// step, stored structure-of-arrays so the same opcode runs across lanes
+// as vector operations. Every per-machine array is indexed
+// [field * stride + lane], memory included, so lanes at the same pc fetch
+// with one load per 32 lanes. The screen is the exception: each lane's
+// rows are contiguous, as DXYN works on one lane's rows at a time.
+//
+// Each step fetches every lane's opcode. When all lanes agree it runs as
+// one vector op; otherwise lanes are grouped by opcode and each large
+// group runs as a vector op masked to its lanes. When the groups cover
+// almost no lanes, the next divergent steps skip the regrouping and run
+// lane by lane. Stack, memory and sprite
+// instructions vectorize per block of 32 lanes that share sp or I. Small
+// groups, CXNN, FX0A, FX33 and 00E0 run lane by lane in ascending lane
+// order, so CXNN draws from the thread's random stream in the same order
+// as executing one instruction on each machine in turn with emulateCycle.
+// Every lane matches emulateCycle exactly.
+struct Batch {
+    int lanes = 0;
+    int stride = 0;                  // lanes rounded up to BATCH_LANE_ALIGN
+    bool simd = true;                // false forces the lane-by-lane path
+
+    std::vector<uint8_t> memory;     // [addr * stride + lane]
+    std::vector<uint8_t> V;          // [reg * stride + lane]
+    std::vector<uint16_t> I;
+    std::vector<uint16_t> pc;
+    std::vector<uint16_t> opcode;
+    std::vector<uint16_t> stack;     // [level * stride + lane]
+    std::vector<uint8_t> sp;
+    std::vector<uint8_t> delayTimer;
+    std::vector<uint8_t> soundTimer;
+    std::vector<uint16_t> keys;      // bit k set while key k is held
+    std::vector<uint64_t> gfx;       // [lane * SCREEN_HEIGHT + row], Chip8::gfx rows
+    std::vector<uint32_t> dirty_rows;
+    std::vector<uint8_t> draw_flag;
+    std::vector<uint8_t> key_wait;
+
+    BatchStats stats;
+
+    // Regrouping scratch for divergent steps
+    std::vector<uint32_t> opcodeGroup;   // [opcode] -> (step stamp << 8) | group
+    std::vector<uint8_t> laneGroup;
+    uint16_t groupOpcode[MAX_GROUPS];
+    uint32_t groupCount[MAX_GROUPS];
+    int groups = 0;
+    uint32_t cutoffLeft = 0;         // divergent steps left to run without regrouping
+};
+
+// Allocates lanes machines, each a copy of image (initialised and loaded).
+void resetBatch(Batch &b, int lanes, const Chip8 &image);
+
+void setLane(Batch &b, int lane, const Chip8 &c);
+void getLane(const Batch &b, int lane, Chip8 &c);
+
+// Runs steps instructions on every lane.
+void runBatch(Batch &b, uint32_t steps);
+
+// One 60 Hz timer tick on every lane.
+void tickBatchTimers(Batch &b);
+
+
+#endif
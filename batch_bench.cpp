@@ -0,0 +1,207 @@
+#include "batch.hpp"
+#include "cpu.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// Batch engine check and benchmark: runs many copies of each ROM in one
+// Batch, every lane with its own pseudo-random key presses so that the
+// lanes diverge, then compares each lane against a Chip8 stepped with
+// emulateCycle, and times the batch against a loop over Chip8 objects.
+//
+//   ./batch_bench [--lanes N] [--frames N] [--cycles N] [--seed N]
+//                 [--same-keys] [--scalar] [--no-verify] [rom ...]
+//
+// --same-keys gives every lane the same input, so lanes only diverge
+// through CXNN. --scalar runs the batch lane by lane (no vector ops) to
+// separate the gain of the layout from that of AVX2.
+
+struct Options {
+    int lanes = 1024;
+    long frames = 600;
+    uint32_t cyclesPerFrame = 8;
+    unsigned seed = 1;
+    bool sameKeys = false;
+    bool simd = true;
+    bool verify = true;
+};
+
+
+static void tickTimers(Chip8 &c) {
+    if (c.delayTimer > 0) --c.delayTimer;
+    if (c.soundTimer > 0) --c.soundTimer;
+}
+
+
+// Keys held by a lane during a frame: every 16 frames each lane picks a
+// key, or none, from its own sequence
+static uint16_t laneKeys(const Options &o, int lane, long frame) {
+    if (o.sameKeys)
+        lane = 0;
+    uint32_t h = static_cast<uint32_t>(lane) * 0x9E3779B1u ^ static_cast<uint32_t>(frame / 16) * 0x85EBCA6Bu;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return (h & 0x30) ? static_cast<uint16_t>(1u << (h % NUM_KEYS)) : 0;
+}
+
+static void setKeys(Chip8 &c, uint16_t keys) {
+    for (int k = 0; k < NUM_KEYS; ++k)
+        c.keys[k] = (keys >> k) & 1;
+}
+
+
+static bool sameState(const Chip8 &a, const Chip8 &b) {
+    return std::memcmp(a.memory, b.memory, sizeof(a.memory)) == 0 &&
+           std::memcmp(a.V, b.V, sizeof(a.V)) == 0 &&
+           a.I == b.I && a.pc == b.pc && a.sp == b.sp &&
+           std::memcmp(a.stack, b.stack, sizeof(a.stack)) == 0 &&
+           a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer &&
+           std::memcmp(a.gfx, b.gfx, sizeof(a.gfx)) == 0 &&
+           a.opcode == b.opcode && a.key_wait == b.key_wait &&
+           a.draw_flag == b.draw_flag && a.dirty_rows == b.dirty_rows;
+}
+
+
+// One instruction per machine in lane order, the order the batch draws
+// random numbers in
+static int verify(const Chip8 &image, const Options &o) {
+    static Batch batch;
+    batch.simd = o.simd;
+    resetBatch(batch, o.lanes, image);
+    std::vector<Chip8> reference(o.lanes, image);
+
+    seedRandom(o.seed);
+    for (long f = 0; f < o.frames; ++f) {
+        for (int l = 0; l < o.lanes; ++l)
+            batch.keys[l] = laneKeys(o, l, f);
+        runBatch(batch, o.cyclesPerFrame);
+        tickBatchTimers(batch);
+    }
+
+    seedRandom(o.seed);
+    for (long f = 0; f < o.frames; ++f) {
+        for (int l = 0; l < o.lanes; ++l)
+            setKeys(reference[l], laneKeys(o, l, f));
+        for (uint32_t i = 0; i < o.cyclesPerFrame; ++i)
+            for (Chip8 &c : reference)
+                emulateCycle(c);
+        for (Chip8 &c : reference)
+            tickTimers(c);
+    }
+
+    int bad = 0;
+    static Chip8 lane;
+    for (int l = 0; l < o.lanes; ++l) {
+        getLane(batch, l, lane);
+        if (!sameState(lane, reference[l])) {
+            if (bad++ == 0)
+                std::cerr << "  lane " << l << " differs: pc " << std::hex << lane.pc << " vs "
+                          << reference[l].pc << std::dec << "\n";
+        }
+    }
+    return bad;
+}
+
+
+// Returns lane-steps per second for the batch, and for a loop that runs
+// each Chip8 for a frame in turn
+static double timeBatch(const Chip8 &image, const Options &o, BatchStats &stats) {
+    static Batch batch;
+    batch.simd = o.simd;
+    resetBatch(batch, o.lanes, image);
+    seedRandom(o.seed);
+
+    auto start = std::chrono::steady_clock::now();
+    for (long f = 0; f < o.frames; ++f) {
+        for (int l = 0; l < o.lanes; ++l)
+            batch.keys[l] = laneKeys(o, l, f);
+        runBatch(batch, o.cyclesPerFrame);
+        tickBatchTimers(batch);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats = batch.stats;
+    return o.lanes * o.frames * static_cast<double>(o.cyclesPerFrame) / seconds;
+}
+
+static double timeObjects(const Chip8 &image, const Options &o) {
+    std::vector<Chip8> machines(o.lanes, image);
+    seedRandom(o.seed);
+
+    auto start = std::chrono::steady_clock::now();
+    for (long f = 0; f < o.frames; ++f) {
+        for (int l = 0; l < o.lanes; ++l) {
+            Chip8 &c = machines[l];
+            setKeys(c, laneKeys(o, l, f));
+            for (uint32_t i = 0; i < o.cyclesPerFrame; ++i)
+                emulateCycle(c);
+            tickTimers(c);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return o.lanes * o.frames * static_cast<double>(o.cyclesPerFrame) / seconds;
+}
+
+
+int main(int argc, char **argv) {
+    Options o;
+    std::vector<std::string> roms;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--lanes" && hasValue)
+            o.lanes = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--frames" && hasValue)
+            o.frames = std::atol(argv[++i]);
+        else if (arg == "--cycles" && hasValue)
+            o.cyclesPerFrame = static_cast<uint32_t>(std::max(1l, std::atol(argv[++i])));
+        else if (arg == "--seed" && hasValue)
+            o.seed = static_cast<unsigned>(std::atol(argv[++i]));
+        else if (arg == "--same-keys")
+            o.sameKeys = true;
+        else if (arg == "--scalar")
+            o.simd = false;
+        else if (arg == "--no-verify")
+            o.verify = false;
+        else
+            roms.push_back(arg);
+    }
+    if (roms.empty())
+        roms = { "PONG.ch8", "Particle Demo [zeroZshadow, 2008].ch8" };
+
+    int failures = 0;
+    for (const std::string &rom : roms) {
+        static Chip8 image;
+        initialise(image);
+        if (!loadROM(rom, image))
+            return 1;
+
+        std::cout << rom << ": " << o.lanes << " lanes, " << o.frames << " frames x "
+                  << o.cyclesPerFrame << " cycles\n";
+        if (o.verify) {
+            int bad = verify(image, o);
+            std::cout << "  verify: " << (bad ? std::to_string(bad) + " lanes differ" : "all lanes match")
+                      << "\n";
+            failures += bad != 0;
+        }
+
+        BatchStats stats;
+        double batch = timeBatch(image, o, stats);
+        double objects = timeObjects(image, o);
+        double steps = static_cast<double>(stats.steps);
+        std::cout << "  batch   " << batch / 1e6 << " M lane-steps/s\n"
+                  << "  objects " << objects / 1e6 << " M lane-steps/s\n"
+                  << "  speedup " << batch / objects << "x\n"
+                  << "  steps: " << 100.0 * stats.uniformSteps / steps << "% uniform vector, "
+                  << stats.vectorGroups / steps << " masked groups/step, "
+                  << 100.0 * stats.scalarLaneOps / (steps * o.lanes) << "% lane ops scalar, "
+                  << 100.0 * stats.cutoffSteps / steps << "% steps past the divergence cutoff\n";
+    }
+    return failures ? 2 : 0;
+}
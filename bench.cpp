@@ -0,0 +1,150 @@
+#include "cpu.hpp"
+#include "engine.hpp"
+#include "expand.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// Headless interpreter benchmark: runs each ROM for a fixed number of
+// 60 Hz frames (8 instructions per frame by default, as in display.cpp)
+// on every engine and reports host time per emulated instruction.
+//
+//   ./bench [--frames N] [--cycles N] [--engine NAME] [--no-fusion] [rom ...]
+//   ./bench --expand [--frames N]
+//
+// Use --engine to isolate one engine under `perf stat -e branch-misses`.
+// The cached engine also reports how often each superinstruction ran;
+// --no-fusion turns the peephole pass off for comparison. --expand times
+// the framebuffer-to-texture kernels instead, checking each against the
+// scalar one.
+
+static uint32_t cyclesPerFrame = 8;
+static bool fusion = true;
+static Core core;
+
+
+static void tickTimers(Chip8 &c) {
+    if (c.delayTimer > 0) --c.delayTimer;
+    if (c.soundTimer > 0) --c.soundTimer;
+}
+
+static double benchOne(Engine e, const std::string &rom, long frames) {
+    Chip8 chip8;
+    initialise(chip8);
+    if (!loadROM(rom, chip8))
+        std::exit(1);
+    seedRandom(1);
+    selectEngine(core, e);
+    core.decode.fusion = fusion;
+
+    auto start = std::chrono::steady_clock::now();
+    for (long f = 0; f < frames; ++f) {
+        runCore(chip8, core, cyclesPerFrame);
+        tickTimers(chip8);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return ns / (static_cast<double>(frames) * cyclesPerFrame);
+}
+
+
+// Expands a random framebuffer frames times per kernel and format
+static int benchExpand(long frames) {
+    uint64_t rows[SCREEN_HEIGHT];
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    for (uint64_t &r : rows) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        r = seed;
+    }
+
+    static uint32_t rgba[SCREEN_HEIGHT * SCREEN_WIDTH], rgbaRef[SCREEN_HEIGHT * SCREEN_WIDTH];
+    static uint8_t gray[SCREEN_HEIGHT * SCREEN_WIDTH], grayRef[SCREEN_HEIGHT * SCREEN_WIDTH];
+
+    std::cout << "framebuffer expansion, best available: " << expandIsaName(expandIsa()) << "\n";
+    for (int i = 0; i <= static_cast<int>(expandIsa()); ++i) {
+        ExpandIsa isa = static_cast<ExpandIsa>(i);
+
+        auto start = std::chrono::steady_clock::now();
+        for (long f = 0; f < frames; ++f) {
+            rows[f % SCREEN_HEIGHT] ^= 1;   // keep the loop from being hoisted
+            expandRGBA(rows, SCREEN_HEIGHT, rgba, 0xFFFFFFFF, 0xFF000000, isa);
+        }
+        auto mid = std::chrono::steady_clock::now();
+        for (long f = 0; f < frames; ++f) {
+            rows[f % SCREEN_HEIGHT] ^= 1;
+            expandGray(rows, SCREEN_HEIGHT, gray, 0xFF, 0x00, isa);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        // Same frame through the scalar kernel must give the same bytes
+        expandRGBA(rows, SCREEN_HEIGHT, rgbaRef, 0xFFFFFFFF, 0xFF000000, ExpandIsa::Scalar);
+        expandGray(rows, SCREEN_HEIGHT, grayRef, 0xFF, 0x00, ExpandIsa::Scalar);
+        expandRGBA(rows, SCREEN_HEIGHT, rgba, 0xFFFFFFFF, 0xFF000000, isa);
+        expandGray(rows, SCREEN_HEIGHT, gray, 0xFF, 0x00, isa);
+        if (std::memcmp(rgba, rgbaRef, sizeof(rgba)) != 0 ||
+            std::memcmp(gray, grayRef, sizeof(gray)) != 0) {
+            std::cerr << expandIsaName(isa) << ": output differs from scalar\n";
+            return 1;
+        }
+
+        double rgbaNs = std::chrono::duration<double, std::nano>(mid - start).count() / frames;
+        double grayNs = std::chrono::duration<double, std::nano>(end - mid).count() / frames;
+        std::cout << "  " << expandIsaName(isa) << ": rgba " << rgbaNs << " ns/frame, gray "
+                  << grayNs << " ns/frame\n";
+    }
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+    long frames = 2'000'000;
+    bool expand = false;
+    std::string only;
+    std::vector<std::string> roms;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+            frames = std::atol(argv[++i]);
+        else if (arg == "--cycles" && i + 1 < argc)
+            cyclesPerFrame = static_cast<uint32_t>(std::atol(argv[++i]));
+        else if (arg == "--engine" && i + 1 < argc)
+            only = argv[++i];
+        else if (arg == "--no-fusion")
+            fusion = false;
+        else if (arg == "--expand")
+            expand = true;
+        else
+            roms.push_back(arg);
+    }
+    if (expand)
+        return benchExpand(frames);
+    if (roms.empty())
+        roms = { "PONG.ch8", "Particle Demo [zeroZshadow, 2008].ch8" };
+
+    for (const std::string &rom : roms) {
+        std::cout << rom << "\n";
+        for (int i = 0; i < static_cast<int>(Engine::COUNT); ++i) {
+            Engine e = static_cast<Engine>(i);
+            if (!only.empty() && only != engineName(e))
+                continue;
+            double nsPerInstr = benchOne(e, rom, frames);
+            std::cout << "  " << engineName(e) << ": "
+                      << nsPerInstr << " ns/instr, "
+                      << 1000.0 / nsPerInstr << " MIPS\n";
+            if (e == Engine::Cached && fusion) {
+                for (int f = 0; f < NUM_FUSED; ++f)
+                    std::cout << "    " << fusedName(static_cast<Fused>(f)) << ": "
+                              << core.decode.fusedHits[f] << " hits\n";
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "blocks.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+
+void resetBlockCache(BlockCache &cache) {
+    for (uint16_t &id : cache.blockAt)
+        id = NO_BLOCK;
+    cache.numBlocks = 0;
+    cache.poolUsed = 0;
+    for (uint64_t &w : cache.code_slots)
+        w = 0;
+}
+
+
+// Drops every live block that covers a slot written since the last sync.
+void syncBlockCache(Chip8 &c, BlockCache &cache) {
+    uint64_t dirty[NUM_WRITE_WORDS];
+    if (!takeWrites(c, cache.code_slots, dirty))
+        return;
+
+    for (uint16_t id = 0; id < cache.numBlocks; ++id) {
+        const Block &b = cache.blocks[id];
+        if (cache.blockAt[b.start >> 1] != id)
+            continue;
+        for (unsigned s = b.start / 2; s < b.start / 2u + b.len; ++s) {
+            if (slotWritten(dirty, s)) {
+                cache.blockAt[b.start >> 1] = NO_BLOCK;
+                break;
+            }
+        }
+    }
+}
+
+
+static uint16_t buildBlock(const Chip8 &c, BlockCache &cache) {
+    if (cache.numBlocks == MAX_BLOCKS ||
+        cache.poolUsed + MAX_BLOCK_LEN > BLOCK_POOL_SIZE)
+        resetBlockCache(cache);
+
+    uint16_t id = cache.numBlocks++;
+    Block &b = cache.blocks[id];
+    b.start = c.pc;
+    b.len = 0;
+    b.first = cache.poolUsed;
+
+    unsigned addr = c.pc;
+    Instr *ops = &cache.pool[b.first];
+    for (;;) {
+        Instr d = decode(readOpcode(c, addr));
+        ops[b.len++] = d;
+        addr += 2;
+        if (isBranch(d.op) || writesMemory(d.op) ||
+            b.len == MAX_BLOCK_LEN || addr + 1 >= MEMORY_SIZE)
+            break;
+    }
+    cache.poolUsed += b.len;
+
+    for (unsigned s = b.start / 2; s < addr / 2; ++s)
+        cache.code_slots[s / 64] |= uint64_t{1} << (s % 64);
+
+    cache.blockAt[b.start >> 1] = id;
+    return id;
+}
+
+
+// Looks up (or builds) the block at pc and charges as much of it as fits
+// in the remaining budget, returning its first micro-op with stop set
+// past the last one to run. A block cut short by the budget stops after
+// its straight-line prefix, which holds no branches or stores. Steps the
+// instruction itself and returns nullptr when pc cannot be cached.
+static const Instr *enterBlock(Chip8 &c, BlockCache &cache, uint32_t &done,
+                               uint32_t budget, const Instr *&stop) {
+    if (c.pc & UNCACHED_PC_MASK) {
+        Instr d = decode(readOpcode(c, c.pc));
+        c.opcode = d.opcode;
+        executeInstr(c, d);
+        ++done;
+        return nullptr;
+    }
+
+    uint16_t id = cache.blockAt[c.pc >> 1];
+    if (id == NO_BLOCK)
+        id = buildBlock(c, cache);
+
+    const Block &b = cache.blocks[id];
+    const Instr *ops = &cache.pool[b.first];
+    uint32_t len = std::min<uint32_t>(b.len, budget - done);
+    done += len;
+    stop = ops + len;
+    return ops;
+}
+
+
+uint32_t runBlocks(Chip8 &c, BlockCache &cache, uint32_t budget) {
+    uint32_t done = 0;
+    const Instr *ip, *stop;
+
+    // Stores made since the last run (loader, other engines)
+    syncBlockCache(c, cache);
+
+#if defined(__GNUC__)
+    static void *const handlers[NUM_OPS] = {
+#define CHIP8_OP_LABEL(name) __extension__ &&op_##name,
+        CHIP8_OPS(CHIP8_OP_LABEL)
+#undef CHIP8_OP_LABEL
+    };
+
+next_block:
+    while (done < budget) {
+        ip = enterBlock(c, cache, done, budget, stop);
+        if (ip)
+            __extension__ ({ goto *handlers[static_cast<uint8_t>(ip->op)]; });
+    }
+    return done;
+
+// Stores and FX0A always end a block, so only their handlers check for
+// overwritten code and a blocked keypad
+#define CHIP8_OP_HANDLER(name)                                              \
+    op_##name:                                                              \
+        execute<Op::name>(c, *ip);                                          \
+        if constexpr (writesMemory(Op::name))                               \
+            syncBlockCache(c, cache);                                       \
+        if constexpr (waitsForKey(Op::name))                                \
+            if (c.key_wait) {                                               \
+                c.opcode = ip->opcode;                                      \
+                return done;                                                \
+            }                                                               \
+        if (++ip == stop)                                                   \
+            goto block_end;                                                 \
+        __extension__ ({ goto *handlers[static_cast<uint8_t>(ip->op)]; });
+    CHIP8_OPS(CHIP8_OP_HANDLER)
+#undef CHIP8_OP_HANDLER
+
+block_end:
+    c.opcode = ip[-1].opcode;
+    goto next_block;
+
+#else
+    while (done < budget) {
+        ip = enterBlock(c, cache, done, budget, stop);
+        if (!ip)
+            continue;
+        for (; ip != stop; ++ip)
+            executeInstr(c, *ip);
+        c.opcode = ip[-1].opcode;
+        if (anyWritten(c))
+            syncBlockCache(c, cache);
+        if (c.key_wait)
+            return done;
+    }
+    return done;
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef BLOCKS_HPP
+#define BLOCKS_HPP
+
+#include "cpu.hpp"
+#include "decode.hpp"
+
+#include <cstdint>
+
+constexpr int MAX_BLOCK_LEN = 32;
+constexpr int BLOCK_POOL_SIZE = 8192;   // micro-ops shared by all blocks
+constexpr int MAX_BLOCKS = 1024;
+constexpr uint16_t NO_BLOCK = 0xFFFF;
+
+// A run of straight-line instructions. The last one is a branch (JP, CALL,
+// RET, skips, BNNN, FX0A), a store (FX33, FX55) or the length cap; the
+// micro-ops live in BlockCache::pool.
+struct Block {
+    uint16_t start;    // address of the first instruction
+    uint16_t len;      // instructions, also the cycles charged
+    uint16_t first;    // index of the first micro-op in the pool
+};
+
+// Basic-block translation cache for one Chip8. Blocks are built on first
+// execution and dropped when a store lands on an instruction slot they
+// cover; when the pool fills up everything is flushed and rebuilt on demand.
+struct BlockCache {
+    uint16_t blockAt[MEMORY_SIZE / 2];           // even address -> block id
+    Block blocks[MAX_BLOCKS];
+    Instr pool[BLOCK_POOL_SIZE];
+    uint16_t numBlocks;
+    uint16_t poolUsed;
+    uint64_t code_slots[NUM_WRITE_WORDS];        // slots covered by any block
+};
+
+void resetBlockCache(BlockCache &cache);
+void syncBlockCache(Chip8 &c, BlockCache &cache);
+
+// Runs blocks until budget instructions have executed, stopping the last
+// one early if it does not fit. Returns the number of instructions executed.
+uint32_t runBlocks(Chip8 &c, BlockCache &cache, uint32_t budget);
+
+
+#endif
@@ -0,0 +1,177 @@
+#include "cpu.hpp"
+#include "decode.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// Ahead-of-time translator: discovers the code reachable from 0x200 in a
+// ROM and writes a C++ translation unit with one function per basic block
+// plus resetAot/runAot (see aot.hpp). Build it with aot.cpp, cpu.cpp and
+// aot_main.cpp for a native per-ROM binary.
+//
+//   ./chip8_aot rom.ch8 out.cpp
+
+constexpr int MAX_AOT_BLOCK_LEN = 64;
+
+struct AotBlock {
+    uint16_t start;
+    std::vector<Instr> instrs;
+};
+
+
+// Follows every statically known control transfer from PROGRAM_START.
+// BNNN targets depend on V0 at run time and are left to the interpreter.
+static std::map<uint16_t, AotBlock> discover(const Chip8 &c) {
+    std::map<uint16_t, AotBlock> blocks;
+    std::vector<unsigned> work{ PROGRAM_START };
+
+    while (!work.empty()) {
+        unsigned start = work.back();
+        work.pop_back();
+        if (start % 2 != 0 || start < PROGRAM_START || start + 1 >= MEMORY_SIZE ||
+            blocks.count(static_cast<uint16_t>(start)))
+            continue;
+
+        AotBlock &b = blocks[static_cast<uint16_t>(start)];
+        b.start = static_cast<uint16_t>(start);
+        unsigned addr = start;
+        for (;;) {
+            Instr d = decode(readOpcode(c, addr));
+            b.instrs.push_back(d);
+            unsigned next = addr + 2;
+
+            if (d.op == Op::JP) {
+                work.push_back(d.nnn);
+            } else if (d.op == Op::CALL) {
+                work.push_back(d.nnn);
+                work.push_back(next);
+            } else if (d.op == Op::LD_VX_K) {
+                work.push_back(addr);       // re-entered while waiting
+                work.push_back(next);
+            } else if (isBranch(d.op)) {
+                if (d.op != Op::RET && d.op != Op::JP_V0) {
+                    work.push_back(next);   // skips
+                    work.push_back(next + 2);
+                }
+            } else if (writesMemory(d.op) || b.instrs.size() == MAX_AOT_BLOCK_LEN ||
+                       next + 1 >= MEMORY_SIZE) {
+                work.push_back(next);
+            } else {
+                addr = next;
+                continue;
+            }
+            break;
+        }
+    }
+    return blocks;
+}
+
+
+static std::string hex(uint64_t v, int width) {
+    std::ostringstream s;
+    s << "0x" << std::uppercase << std::hex << std::setw(width) << std::setfill('0') << v;
+    return s.str();
+}
+
+static void emit(std::ostream &out, const std::string &romName,
+                 const uint8_t *rom, size_t size,
+                 const std::map<uint16_t, AotBlock> &blocks) {
+    out << "// Generated by chip8_aot from " << romName << ". Do not edit.\n"
+        << "#include \"aot.hpp\"\n\n\n";
+
+    out << "static const uint8_t ROM[] = {";
+    for (size_t i = 0; i < size; ++i)
+        out << (i % 12 == 0 ? "\n    " : " ") << hex(rom[i], 2) << ",";
+    out << "\n};\n\n";
+
+    uint64_t slots[NUM_WRITE_WORDS] = {};
+    for (const auto &[start, b] : blocks)
+        for (unsigned s = start / 2u; s < start / 2u + b.instrs.size(); ++s)
+            slots[s / 64] |= uint64_t{1} << (s % 64);
+    out << "static constexpr uint64_t CODE_SLOTS[NUM_WRITE_WORDS] = {";
+    for (int w = 0; w < NUM_WRITE_WORDS; ++w)
+        out << (w % 2 == 0 ? "\n    " : " ") << hex(slots[w], 16) << "ull,";
+    out << "\n};\n\n";
+
+    for (const auto &[start, b] : blocks) {
+        out << "\n// " << hex(start, 3) << " - " << hex(start + 2 * b.instrs.size() - 1, 3) << "\n"
+            << "static void block_" << hex(start, 3).substr(2) << "(Chip8 &c) {\n";
+        for (const Instr &d : b.instrs)
+            out << "    executeOpcode<" << hex(d.opcode, 4) << ">(c);\n";
+        out << "    c.opcode = " << hex(b.instrs.back().opcode, 4) << ";\n"
+            << "}\n";
+    }
+
+    out << "\n\nvoid resetAot(Chip8 &c, AotState &s) {\n"
+        << "    aotReset(c, s, ROM, sizeof(ROM));\n"
+        << "}\n\n\n";
+
+    out << "uint32_t runAot(Chip8 &c, AotState &s, uint32_t budget) {\n"
+        << "    uint32_t done = 0;\n\n"
+        << "    if (anyWritten(c))\n"
+        << "        aotSync(c, s, CODE_SLOTS);\n\n"
+        << "    while (done < budget) {\n"
+        << "        switch (c.pc) {\n";
+    for (const auto &[start, b] : blocks) {
+        std::string name = hex(start, 3).substr(2);
+        out << "            case " << hex(start, 3) << ":\n"
+            << "                if (!aotEnter(s, done, budget, " << hex(start, 3) << ", "
+            << b.instrs.size() << "))\n"
+            << "                    break;\n"
+            << "                block_" << name << "(c);\n";
+        if (writesMemory(b.instrs.back().op))
+            out << "                if (anyWritten(c))\n"
+                << "                    aotSync(c, s, CODE_SLOTS);\n";
+        if (waitsForKey(b.instrs.back().op))
+            out << "                if (c.key_wait)\n"
+                << "                    return done;\n";
+        out << "                continue;\n";
+    }
+    out << "            default:\n"
+        << "                break;\n"
+        << "        }\n"
+        << "        aotInterpret(c, s, CODE_SLOTS);\n"
+        << "        ++done;\n"
+        << "    }\n"
+        << "    return done;\n"
+        << "}\n";
+}
+
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " rom.ch8 out.cpp\n";
+        return 1;
+    }
+
+    Chip8 chip8;
+    initialise(chip8);
+    if (!loadROM(argv[1], chip8))
+        return 1;
+
+    std::ifstream rom(argv[1], std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(rom)),
+                               std::istreambuf_iterator<char>());
+
+    std::map<uint16_t, AotBlock> blocks = discover(chip8);
+
+    std::ofstream out(argv[2]);
+    if (!out) {
+        std::cerr << "Failed to open output: " << argv[2] << "\n";
+        return 1;
+    }
+    emit(out, argv[1], bytes.data(), bytes.size(), blocks);
+
+    size_t instrs = 0;
+    for (const auto &[start, b] : blocks)
+        instrs += b.instrs.size();
+    std::cout << blocks.size() << " blocks, " << instrs << " instructions\n";
+    return 0;
+}
@@ -23,12 +23,15 @@ void initialise(Chip8 &chip8) {
     std::memset(chip8.memory, 0, sizeof(chip8.memory));
     std::memset(chip8.V, 0, sizeof(chip8.V));
     std::memset(chip8.stack, 0, sizeof(chip8.stack));
-    std::memset(chip8.gfx, 0, sizeof(chip8.gfx));
+    clearScreen(chip8);
     std::memset(chip8.keys, 0, sizeof(chip8.keys));
 
     chip8.delayTimer = 0;
     chip8.soundTimer = 0;
     chip8.draw_flag = false;
+    chip8.key_wait = false;
+    std::memset(chip8.mem_dirty, 0xFF, sizeof(chip8.mem_dirty));
+    chip8.mem_dirty_words = ~uint32_t{0};
 
     // Standard CHIP-8 font set (0–F)
     const uint8_t fontset[80] = {
@@ -54,7 +57,7 @@ void initialise(Chip8 &chip8) {
         chip8.memory[i] = fontset[i];
 
     // Seed random number generator
-    std::srand(std::time(nullptr));
+    seedRandom(static_cast<unsigned>(std::time(nullptr)));
 }
 
 
@@ -71,7 +74,7 @@ void emulateCycle(Chip8 &c) {
         case OpcodeFamily::SYS:
             switch (static_cast<SysOpcode>(nn)) {
                 case SysOpcode::CLS:
-                    std::memset(c.gfx, 0, sizeof(c.gfx));
+                    clearScreen(c);
                     c.draw_flag = true;
                     c.pc += 2;
                     break;
@@ -182,24 +185,12 @@ void emulateCycle(Chip8 &c) {
             break;
 
         case OpcodeFamily::RAND: // CXNN - Set Vx = random byte AND NN
-            c.V[x] = (std::rand() % 256) & nn;
+            c.V[x] = randomByte() & nn;
             c.pc += 2;
             break;
 
         case OpcodeFamily::DRAW: // DXYN - Draw sprite
-            c.V[0xF] = 0;
-            for (int row = 0; row < n; ++row) {
-                uint8_t sprite = c.memory[c.I + row];
-                for (int col = 0; col < 8; ++col) {
-                    if (sprite & (0x80 >> col)) {
-                        int px = (c.V[x] + col) % SCREEN_WIDTH;
-                        int py = (c.V[y] + row) % SCREEN_HEIGHT;
-                        if (c.gfx[py][px])
-                            c.V[0xF] = 1;
-                        c.gfx[py][px] ^= 1;
-                    }
-                }
-            }
+            drawSprite(c, c.V, x, y, c.I, n);
             c.draw_flag = true;
             c.pc += 2;
             break;
@@ -250,6 +241,7 @@ void emulateCycle(Chip8 &c) {
                                     break;
                                 }
                             }
+                            c.key_wait = !key_pressed;
                             if (!key_pressed)
                                 return; // Don't increment PC, wait for key
                             break;
@@ -263,12 +255,14 @@ void emulateCycle(Chip8 &c) {
                             c.memory[c.I] = c.V[x] / 100;
                             c.memory[c.I + 1] = (c.V[x] / 10) % 10;
                             c.memory[c.I + 2] = c.V[x] % 10;
+                            markWritten(c, c.I, 3);
                             break;
                         }
 
                         case 0x55: // FX55 - Store V0 to Vx in memory starting at I
                             for (int i = 0; i <= x; ++i)
                                 c.memory[c.I + i] = c.V[i];
+                            markWritten(c, c.I, x + 1);
                             break;
 
                         case 0x65: // FX65 - Read V0 to Vx from memory starting at I
@@ -308,5 +302,42 @@ bool loadROM(std::string_view filename, Chip8 &chip8) {
 
     rom.seekg(0, std::ios::beg);
     rom.read(reinterpret_cast<char*>(&chip8.memory[PROGRAM_START]), size);
+    markWritten(chip8, PROGRAM_START, static_cast<unsigned>(size));
     return true;
-}
\ No newline at end of file
+}
+
+
+static uint64_t fnv(uint64_t h, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        h ^= (value >> (8 * i)) & 0xFF;
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+constexpr uint64_t FNV_OFFSET = 0xCBF29CE484222325ull;
+
+
+uint64_t screenHash(const Chip8 &c) {
+    uint64_t h = FNV_OFFSET;
+    for (uint64_t row : c.gfx)
+        h = fnv(h, row, 8);
+    return h;
+}
+
+
+uint64_t stateHash(const Chip8 &c) {
+    uint64_t h = screenHash(c);
+    for (uint8_t b : c.memory)
+        h = fnv(h, b, 1);
+    for (uint8_t v : c.V)
+        h = fnv(h, v, 1);
+    for (uint16_t s : c.stack)
+        h = fnv(h, s, 2);
+    h = fnv(h, c.I, 2);
+    h = fnv(h, c.pc, 2);
+    h = fnv(h, c.sp, 1);
+    h = fnv(h, c.delayTimer, 1);
+    h = fnv(h, c.soundTimer, 1);
+    return h;
+}
@@ -1,10 +1,12 @@
 #ifndef CPU_HPP
 #define CPU_HPP
 
+#include <bit>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <string_view>
 
 constexpr int NUM_REGISTERS = 16;
 constexpr int MEMORY_SIZE = 4096;
@@ -24,6 +26,8 @@ constexpr int H_BUFFER_SIZE = 36;
 constexpr int X_MAIN_WINDOW_SIZE = 320;
 constexpr int Y_MAIN_WINDOW_SIZE = 500;
 constexpr int STACK_SIZE = 16;
+constexpr int NUM_WRITE_SLOTS = MEMORY_SIZE / 2;  // one per instruction slot
+constexpr int NUM_WRITE_WORDS = NUM_WRITE_SLOTS / 64;
 
 
 struct Chip8 {
@@ -41,8 +45,11 @@ struct Chip8 {
   uint8_t delayTimer;
   uint8_t soundTimer;
 
-  // bool gfx[SCREEN_WIDTH * SCREEN_HEIGHT];
-  bool gfx[SCREEN_HEIGHT][SCREEN_WIDTH];
+  // One bit per pixel, one word per row; x = 0 is the most significant bit
+  uint64_t gfx[SCREEN_HEIGHT];
+
+  // One bit per gfx row changed since the front end last uploaded it
+  uint32_t dirty_rows;
 
   // Keypad
   bool keys[NUM_KEYS];
@@ -51,8 +58,115 @@ struct Chip8 {
   uint16_t opcode;
 
   bool draw_flag;
+
+  // Set while FX0A finds no key held; pc stays on the FX0A until one is
+  bool key_wait;
+
+  // One bit per 2-byte instruction slot, set whenever memory is written
+  // (loader, FX33, FX55), plus one summary bit per non-zero word.
+  // Decode caches consume and clear both.
+  uint64_t mem_dirty[NUM_WRITE_WORDS];
+  uint32_t mem_dirty_words;
 };
 
+
+// True while FX0A is waiting and no key is down. Running the machine would
+// only re-execute the FX0A, so run loops stop issuing cycles.
+inline bool blockedOnKey(const Chip8 &c) {
+    if (!c.key_wait)
+        return false;
+    for (bool k : c.keys)
+        if (k)
+            return false;
+    return true;
+}
+
+
+inline bool pixelAt(const Chip8 &c, int x, int y) {
+    return (c.gfx[y] >> (SCREEN_WIDTH - 1 - x)) & 1;
+}
+
+
+// 00E0
+inline void clearScreen(Chip8 &c) {
+    std::memset(c.gfx, 0, sizeof(c.gfx));
+    c.dirty_rows = ~uint32_t{0};
+}
+
+
+// DXYN: XORs an n-row sprite from memory[I] onto gfx at (V[x], V[y]) and
+// sets V[0xF] to the collision flag and marks the rows it touched in
+// dirty_rows. V is passed separately so batched interpreters can keep
+// registers in locals.
+inline void drawSprite(Chip8 &c, uint8_t *V, unsigned x, unsigned y, unsigned I, unsigned n) {
+    static_assert(SCREEN_WIDTH == 64, "one uint64_t per row");
+
+    if (x != 0xF && y != 0xF) {
+        // Each sprite row is one mask rotated into place, so the horizontal
+        // wrap comes for free and collision is a single AND
+        unsigned shift = V[x] % SCREEN_WIDTH;
+        uint64_t hit = 0;
+        for (unsigned row = 0; row < n; ++row) {
+            uint64_t mask = std::rotr(uint64_t{c.memory[I + row]} << 56, static_cast<int>(shift));
+            unsigned py = (V[y] + row) % SCREEN_HEIGHT;
+            hit |= c.gfx[py] & mask;
+            c.gfx[py] ^= mask;
+            c.dirty_rows |= uint32_t{1} << py;
+        }
+        V[0xF] = hit != 0;
+        return;
+    }
+
+    // VF as a coordinate changes as soon as a collision sets it, so step
+    // pixel by pixel exactly as the reference loop does
+    V[0xF] = 0;
+    for (unsigned row = 0; row < n; ++row) {
+        uint8_t sprite = c.memory[I + row];
+        for (int col = 0; col < 8; ++col) {
+            if (sprite & (0x80 >> col)) {
+                int px = (V[x] + col) % SCREEN_WIDTH;
+                int py = (V[y] + row) % SCREEN_HEIGHT;
+                uint64_t bit = uint64_t{1} << (SCREEN_WIDTH - 1 - px);
+                if (c.gfx[py] & bit)
+                    V[0xF] = 1;
+                c.gfx[py] ^= bit;
+                c.dirty_rows |= uint32_t{1} << py;
+            }
+        }
+    }
+}
+
+
+// Records a store of len bytes at addr for the decode caches.
+inline void markWritten(Chip8 &c, unsigned addr, unsigned len) {
+    if (len == 0)
+        return;
+    unsigned first = (addr % MEMORY_SIZE) / 2;
+    unsigned last = ((addr + len - 1) % MEMORY_SIZE) / 2;
+    for (unsigned s = first;; s = (s + 1) % NUM_WRITE_SLOTS) {
+        c.mem_dirty[s / 64] |= uint64_t{1} << (s % 64);
+        c.mem_dirty_words |= uint32_t{1} << (s / 64);
+        if (s == last)
+            break;
+    }
+}
+
+
+// CXNN's random source: the ANSI C rand() generator with one stream per
+// thread, so machines run on different threads neither race nor disturb
+// each other's sequence. initialise seeds the calling thread's stream from
+// the clock; seedRandom makes a run reproducible.
+inline thread_local uint32_t randomState = 1;
+
+inline void seedRandom(unsigned seed) {
+    randomState = seed;
+}
+
+inline uint8_t randomByte() {
+    randomState = randomState * 1103515245u + 12345u;
+    return static_cast<uint8_t>(randomState >> 16);
+}
+
 enum class OpcodeFamily : uint16_t {
   SYS   = 0x0000,
   JP    = 0x1000,
@@ -107,4 +221,60 @@ enum class KeyOpcode : uint8_t {
 };
 
 
+void initialise(Chip8 &chip8);
+void emulateCycle(Chip8 &c);
+bool loadROM(std::string_view filename, Chip8 &chip8);
+
+// FNV-1a over the screen, and over everything that decides what runs next
+// (memory, registers, stack, timers, screen). Values are hashed rather
+// than bytes, so results are stable across hosts, engines and builds.
+uint64_t screenHash(const Chip8 &c);
+uint64_t stateHash(const Chip8 &c);
+
+// Table-dispatched interpreter (dispatch.cpp). Same semantics as emulateCycle.
+void emulateCycleTable(Chip8 &c);
+uint32_t runTable(Chip8 &c, uint32_t budget);
+
+// Per-opcode specialised handlers (specialized.cpp). Same semantics as emulateCycle.
+void emulateCycleSpecialized(Chip8 &c);
+uint32_t runSpecialized(Chip8 &c, uint32_t budget);
+
+// Why runCycles returned.
+enum class StopReason : uint8_t {
+  Budget,          // ran the whole budget
+  Draw,            // CLS or DXYN changed gfx (draw_flag is set)
+  KeyWait,         // FX0A found no key held (key_wait is set)
+  Breakpoint,      // pc is on a breakpoint, which has not run yet
+  InvalidOpcode    // ran an undefined opcode as a no-op; it is in opcode
+};
+
+struct RunResult {
+  uint32_t cycles;
+  StopReason reason;
+};
+
+// One bit per memory address.
+struct Breakpoints {
+  uint64_t bits[MEMORY_SIZE / 64];
+};
+
+inline void setBreakpoint(Breakpoints &b, unsigned addr, bool on) {
+    uint64_t bit = uint64_t{1} << (addr % 64);
+    if (on)
+        b.bits[addr / 64 % (MEMORY_SIZE / 64)] |= bit;
+    else
+        b.bits[addr / 64 % (MEMORY_SIZE / 64)] &= ~bit;
+}
+
+inline bool hasBreakpoint(const Breakpoints &b, unsigned addr) {
+    return (b.bits[addr / 64 % (MEMORY_SIZE / 64)] >> (addr % 64)) & 1;
+}
+
+// Batched interpreter (cycles.cpp). Runs up to budget instructions with pc,
+// I, sp and V held in locals and stops early for the reasons above. A
+// breakpoint on the first instruction is ignored so a stopped run resumes.
+// Same semantics as emulateCycle.
+RunResult runCycles(Chip8 &c, uint32_t budget, const Breakpoints *breaks = nullptr);
+
+
 #endif
\ No newline at end of file
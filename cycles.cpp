@@ -0,0 +1,223 @@
+#include "cpu.hpp"
+#include "decode.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+
+// Batched interpreter. emulateCycle and the execute<Op> handlers go through
+// Chip8& for every register access, and because memory is a byte array
+// every store to it forces pc, I and V to be reloaded. Here the hot state
+// lives in locals for the whole batch and is written back once on return.
+
+template <bool BREAKS>
+static RunResult run(Chip8 &c, uint32_t budget, const Breakpoints *breaks) {
+    uint16_t pc = c.pc;
+    uint16_t I = c.I;
+    uint8_t sp = c.sp;
+    uint16_t opcode = c.opcode;
+    uint8_t V[NUM_REGISTERS];
+    std::memcpy(V, c.V, sizeof(V));
+
+    uint32_t done = 0;
+    StopReason reason = StopReason::Budget;
+
+    while (done < budget) {
+        if constexpr (BREAKS) {
+            if (done > 0 && hasBreakpoint(*breaks, pc)) {
+                reason = StopReason::Breakpoint;
+                break;
+            }
+        }
+
+        opcode = readOpcode(c, pc);
+        const Instr d = decode(opcode);
+        const uint8_t x = d.x;
+        const uint8_t y = d.y;
+        ++done;
+
+        switch (d.op) {
+            case Op::NOP:
+                pc += 2;
+                // 0NNN is a machine-code call, ignored; anything else is undefined
+                if (opcode & 0xF000) {
+                    reason = StopReason::InvalidOpcode;
+                    goto stop;
+                }
+                break;
+            case Op::CLS:
+                clearScreen(c);
+                c.draw_flag = true;
+                pc += 2;
+                reason = StopReason::Draw;
+                goto stop;
+            case Op::RET:
+                pc = c.stack[--sp];
+                break;
+            case Op::JP:
+                pc = d.nnn;
+                break;
+            case Op::CALL:
+                c.stack[sp++] = pc + 2;
+                pc = d.nnn;
+                break;
+            case Op::SE_VX_NN:
+                pc += (V[x] == d.nn()) ? 4 : 2;
+                break;
+            case Op::SNE_VX_NN:
+                pc += (V[x] != d.nn()) ? 4 : 2;
+                break;
+            case Op::SE_VX_VY:
+                pc += (V[x] == V[y]) ? 4 : 2;
+                break;
+            case Op::LD_VX_NN:
+                V[x] = d.nn();
+                pc += 2;
+                break;
+            case Op::ADD_VX_NN:
+                V[x] += d.nn();
+                pc += 2;
+                break;
+            case Op::LD_VX_VY:
+                V[x] = V[y];
+                pc += 2;
+                break;
+            case Op::OR:
+                V[x] |= V[y];
+                pc += 2;
+                break;
+            case Op::AND:
+                V[x] &= V[y];
+                pc += 2;
+                break;
+            case Op::XOR:
+                V[x] ^= V[y];
+                pc += 2;
+                break;
+            case Op::ADD_VX_VY: {
+                uint16_t sum = V[x] + V[y];
+                V[0xF] = sum > 0xFF;
+                V[x] = sum & 0xFF;
+                pc += 2;
+                break;
+            }
+            case Op::SUB:
+                V[0xF] = V[x] >= V[y];
+                V[x] -= V[y];
+                pc += 2;
+                break;
+            case Op::SHR:
+                V[0xF] = V[x] & 0x01;
+                V[x] >>= 1;
+                pc += 2;
+                break;
+            case Op::SUBN:
+                V[0xF] = V[y] >= V[x];
+                V[x] = V[y] - V[x];
+                pc += 2;
+                break;
+            case Op::SHL:
+                V[0xF] = (V[x] & 0x80) >> 7;
+                V[x] <<= 1;
+                pc += 2;
+                break;
+            case Op::SNE_VX_VY:
+                pc += (V[x] != V[y]) ? 4 : 2;
+                break;
+            case Op::LD_I:
+                I = d.nnn;
+                pc += 2;
+                break;
+            case Op::JP_V0:
+                pc = d.nnn + V[0];
+                break;
+            case Op::RND:
+                V[x] = randomByte() & d.nn();
+                pc += 2;
+                break;
+            case Op::DRW:
+                drawSprite(c, V, x, y, I, d.n);
+                c.draw_flag = true;
+                pc += 2;
+                reason = StopReason::Draw;
+                goto stop;
+            case Op::SKP:
+                pc += c.keys[V[x]] ? 4 : 2;
+                break;
+            case Op::SKNP:
+                pc += !c.keys[V[x]] ? 4 : 2;
+                break;
+            case Op::LD_VX_DT:
+                V[x] = c.delayTimer;
+                pc += 2;
+                break;
+            case Op::LD_VX_K:
+                c.key_wait = true;
+                for (int i = 0; i < NUM_KEYS; ++i) {
+                    if (c.keys[i]) {
+                        V[x] = i;
+                        pc += 2;
+                        c.key_wait = false;
+                        break;
+                    }
+                }
+                if (c.key_wait) {
+                    reason = StopReason::KeyWait;
+                    goto stop;
+                }
+                break;
+            case Op::LD_DT_VX:
+                c.delayTimer = V[x];
+                pc += 2;
+                break;
+            case Op::LD_ST_VX:
+                c.soundTimer = V[x];
+                pc += 2;
+                break;
+            case Op::ADD_I_VX:
+                I += V[x];
+                pc += 2;
+                break;
+            case Op::LD_F_VX:
+                I = V[x] * 5;
+                pc += 2;
+                break;
+            case Op::LD_B_VX:
+                c.memory[I] = V[x] / 100;
+                c.memory[I + 1] = (V[x] / 10) % 10;
+                c.memory[I + 2] = V[x] % 10;
+                markWritten(c, I, 3);
+                pc += 2;
+                break;
+            case Op::LD_I_VX:
+                for (int i = 0; i <= x; ++i)
+                    c.memory[I + i] = V[i];
+                markWritten(c, I, x + 1);
+                pc += 2;
+                break;
+            case Op::LD_VX_I:
+                for (int i = 0; i <= x; ++i)
+                    V[i] = c.memory[I + i];
+                pc += 2;
+                break;
+            default:
+                break;
+        }
+    }
+
+stop:
+    c.pc = pc;
+    c.I = I;
+    c.sp = sp;
+    c.opcode = opcode;
+    std::memcpy(c.V, V, sizeof(V));
+    return RunResult{ done, reason };
+}
+
+
+RunResult runCycles(Chip8 &c, uint32_t budget, const Breakpoints *breaks) {
+    if (breaks)
+        return run<true>(c, budget, breaks);
+    return run<false>(c, budget, breaks);
+}
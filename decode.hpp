@@ -0,0 +1,403 @@
+#ifndef DECODE_HPP
+#define DECODE_HPP
+
+#include "cpu.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Every distinct instruction behaviour, in handler-table order.
+// Opcodes emulateCycle treats as "just advance pc" all decode to NOP.
+#define CHIP8_OPS(X) \
+    X(NOP)        \
+    X(CLS)        \
+    X(RET)        \
+    X(JP)         \
+    X(CALL)       \
+    X(SE_VX_NN)   \
+    X(SNE_VX_NN)  \
+    X(SE_VX_VY)   \
+    X(LD_VX_NN)   \
+    X(ADD_VX_NN)  \
+    X(LD_VX_VY)   \
+    X(OR)         \
+    X(AND)        \
+    X(XOR)        \
+    X(ADD_VX_VY)  \
+    X(SUB)        \
+    X(SHR)        \
+    X(SUBN)       \
+    X(SHL)        \
+    X(SNE_VX_VY)  \
+    X(LD_I)       \
+    X(JP_V0)      \
+    X(RND)        \
+    X(DRW)        \
+    X(SKP)        \
+    X(SKNP)       \
+    X(LD_VX_DT)   \
+    X(LD_VX_K)    \
+    X(LD_DT_VX)   \
+    X(LD_ST_VX)   \
+    X(ADD_I_VX)   \
+    X(LD_F_VX)    \
+    X(LD_B_VX)    \
+    X(LD_I_VX)    \
+    X(LD_VX_I)
+
+enum class Op : uint8_t {
+#define CHIP8_OP_ENUM(name) name,
+    CHIP8_OPS(CHIP8_OP_ENUM)
+#undef CHIP8_OP_ENUM
+    COUNT
+};
+
+constexpr int NUM_OPS = static_cast<int>(Op::COUNT);
+
+// One instruction with its operand fields already extracted.
+struct Instr {
+    Op op;
+    uint8_t x;
+    uint8_t y;
+    uint8_t n;
+    uint16_t nnn;
+    uint16_t opcode;
+
+    constexpr uint8_t nn() const { return static_cast<uint8_t>(nnn & 0x00FF); }
+};
+
+
+// Maps an opcode to its handler, following the same case analysis as emulateCycle.
+constexpr Op decodeOp(uint16_t opcode) {
+    uint8_t nn = opcode & 0x00FF;
+    uint8_t n = opcode & 0x000F;
+
+    switch (static_cast<OpcodeFamily>(opcode & 0xF000)) {
+        case OpcodeFamily::SYS:
+            switch (static_cast<SysOpcode>(nn)) {
+                case SysOpcode::CLS: return Op::CLS;
+                case SysOpcode::RET: return Op::RET;
+                default:             return Op::NOP;
+            }
+        case OpcodeFamily::JP:     return Op::JP;
+        case OpcodeFamily::CALL:   return Op::CALL;
+        case OpcodeFamily::SE_VX:  return Op::SE_VX_NN;
+        case OpcodeFamily::SNE_VX: return Op::SNE_VX_NN;
+        case OpcodeFamily::SE_VY:  return Op::SE_VX_VY;
+        case OpcodeFamily::LD:     return Op::LD_VX_NN;
+        case OpcodeFamily::ADD:    return Op::ADD_VX_NN;
+        case OpcodeFamily::ALU:
+            switch (static_cast<AluOpcode>(n)) {
+                case AluOpcode::LD:   return Op::LD_VX_VY;
+                case AluOpcode::OR:   return Op::OR;
+                case AluOpcode::AND:  return Op::AND;
+                case AluOpcode::XOR:  return Op::XOR;
+                case AluOpcode::ADD:  return Op::ADD_VX_VY;
+                case AluOpcode::SUB:  return Op::SUB;
+                case AluOpcode::SHR:  return Op::SHR;
+                case AluOpcode::SUBN: return Op::SUBN;
+                case AluOpcode::SHL:  return Op::SHL;
+                default:              return Op::NOP;
+            }
+        case OpcodeFamily::SNE:    return Op::SNE_VX_VY;
+        case OpcodeFamily::LD_I:   return Op::LD_I;
+        case OpcodeFamily::JP_V0:  return Op::JP_V0;
+        case OpcodeFamily::RAND:   return Op::RND;
+        case OpcodeFamily::DRAW:   return Op::DRW;
+        case OpcodeFamily::KEY:
+            switch (static_cast<KeyOpcode>(nn)) {
+                case KeyOpcode::SKP:  return Op::SKP;
+                case KeyOpcode::SKNP: return Op::SKNP;
+                default:              return Op::NOP;
+            }
+        case OpcodeFamily::MISC:
+            switch (static_cast<MiscOpcode>(nn)) {
+                case MiscOpcode::LD_DT:   return Op::LD_VX_DT;
+                case MiscOpcode::LD_KEY:  return Op::LD_VX_K;
+                case MiscOpcode::SET_DT:  return Op::LD_DT_VX;
+                case MiscOpcode::SET_ST:  return Op::LD_ST_VX;
+                case MiscOpcode::ADD_I:   return Op::ADD_I_VX;
+                case MiscOpcode::LD_FONT: return Op::LD_F_VX;
+                case MiscOpcode::LD_BCD:  return Op::LD_B_VX;
+                case MiscOpcode::STORE:   return Op::LD_I_VX;
+                case MiscOpcode::LOAD:    return Op::LD_VX_I;
+                default:                  return Op::NOP;
+            }
+    }
+    return Op::NOP;
+}
+
+// The handler only depends on the top nibble and the low byte of the opcode,
+// so the whole decode collapses into one flat 4 KB table.
+constexpr uint16_t opTableIndex(uint16_t opcode) {
+    return ((opcode & 0xF000) >> 4) | (opcode & 0x00FF);
+}
+
+inline constexpr std::array<Op, 4096> OP_TABLE = [] {
+    std::array<Op, 4096> table{};
+    for (int i = 0; i < 4096; ++i)
+        table[i] = decodeOp(static_cast<uint16_t>(((i & 0xF00) << 4) | (i & 0xFF)));
+    return table;
+}();
+
+// pc values that cannot index a per-even-address cache: odd addresses and
+// anything past the end of memory take an uncached decode path.
+constexpr uint16_t UNCACHED_PC_MASK = 0xF001;
+
+inline uint16_t readOpcode(const Chip8 &c, unsigned addr) {
+    return static_cast<uint16_t>((c.memory[addr] << 8) | c.memory[addr + 1]);
+}
+
+inline bool anyWritten(const Chip8 &c) {
+    return c.mem_dirty_words != 0;
+}
+
+// Moves the slots written since the last call into dirty and clears them
+// in c. Returns whether any of them overlap code (a set bit in code);
+// dirty is only filled in when something was written.
+inline bool takeWrites(Chip8 &c, const uint64_t *code, uint64_t *dirty) {
+    if (!anyWritten(c))
+        return false;
+    bool hitsCode = false;
+    for (int w = 0; w < NUM_WRITE_WORDS; ++w) {
+        dirty[w] = (c.mem_dirty_words >> w) & 1 ? c.mem_dirty[w] : 0;
+        c.mem_dirty[w] = 0;
+        hitsCode |= (dirty[w] & code[w]) != 0;
+    }
+    c.mem_dirty_words = 0;
+    return hitsCode;
+}
+
+inline bool slotWritten(const uint64_t *dirty, unsigned slot) {
+    return (dirty[slot / 64] >> (slot % 64)) & 1;
+}
+
+// Fast-forwards a delay-timer busy wait: FX07 / 3X00 / 1NNN jumping back
+// to the FX07. The timers only move between runs, so once pc is inside
+// such a loop with delayTimer non-zero it stays there for the rest of the
+// budget, changing nothing but V[x], pc and opcode. Applies those effects
+// directly and returns budget, or returns 0 when pc is not idling.
+inline uint32_t skipIdleLoop(Chip8 &c, uint32_t budget) {
+    if (c.delayTimer == 0 || budget == 0 || (c.pc & UNCACHED_PC_MASK))
+        return 0;
+
+    for (unsigned k = 0; k < 3 && 2 * k <= c.pc; ++k) {     // pc = head + 2k
+        unsigned head = c.pc - 2 * k;
+        if (head + 6 > MEMORY_SIZE)
+            continue;
+        uint16_t ops[3] = {
+            readOpcode(c, head), readOpcode(c, head + 2), readOpcode(c, head + 4)
+        };
+        unsigned x = (ops[0] >> 8) & 0xF;
+        if (ops[0] != (0xF007 | x << 8) || ops[1] != (0x3000 | x << 8) ||
+            ops[2] != (0x1000 | head))
+            continue;
+        // Entered at the 3X00 with V[x] already zero: the loop exits.
+        if (k == 1 && c.V[x] == 0)
+            return 0;
+
+        if (budget > (3 - k) % 3)     // the FX07 runs at least once
+            c.V[x] = c.delayTimer;
+        c.opcode = ops[(k + budget - 1) % 3];
+        c.pc = static_cast<uint16_t>(head + 2 * ((k + budget) % 3));
+        return budget;
+    }
+    return 0;
+}
+
+constexpr Instr decode(uint16_t opcode) {
+    return Instr{
+        OP_TABLE[opTableIndex(opcode)],
+        static_cast<uint8_t>((opcode & 0x0F00) >> 8),
+        static_cast<uint8_t>((opcode & 0x00F0) >> 4),
+        static_cast<uint8_t>(opcode & 0x000F),
+        static_cast<uint16_t>(opcode & 0x0FFF),
+        opcode
+    };
+}
+
+// Instructions that store into memory and so may overwrite cached code.
+constexpr bool writesMemory(Op op) {
+    return op == Op::LD_B_VX || op == Op::LD_I_VX;
+}
+
+// Instructions that can leave the machine blocked on the keypad
+// (Chip8::key_wait), after which run loops return early.
+constexpr bool waitsForKey(Op op) {
+    return op == Op::LD_VX_K;
+}
+
+// Instructions after which pc is not simply pc + 2.
+constexpr bool isBranch(Op op) {
+    switch (op) {
+        case Op::RET:
+        case Op::JP:
+        case Op::CALL:
+        case Op::SE_VX_NN:
+        case Op::SNE_VX_NN:
+        case Op::SE_VX_VY:
+        case Op::SNE_VX_VY:
+        case Op::JP_V0:
+        case Op::SKP:
+        case Op::SKNP:
+        case Op::LD_VX_K:
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+// Executes one decoded instruction. Behaviour matches the corresponding
+// case of emulateCycle exactly, including the pc update.
+template <Op O>
+inline void execute(Chip8 &c, const Instr &d) {
+    const uint8_t x = d.x;
+    const uint8_t y = d.y;
+
+    if constexpr (O == Op::NOP) {
+        c.pc += 2;
+    } else if constexpr (O == Op::CLS) {
+        clearScreen(c);
+        c.draw_flag = true;
+        c.pc += 2;
+    } else if constexpr (O == Op::RET) {
+        c.pc = c.stack[--c.sp];
+    } else if constexpr (O == Op::JP) {
+        c.pc = d.nnn;
+    } else if constexpr (O == Op::CALL) {
+        c.stack[c.sp++] = c.pc + 2;
+        c.pc = d.nnn;
+    } else if constexpr (O == Op::SE_VX_NN) {
+        c.pc += (c.V[x] == d.nn()) ? 4 : 2;
+    } else if constexpr (O == Op::SNE_VX_NN) {
+        c.pc += (c.V[x] != d.nn()) ? 4 : 2;
+    } else if constexpr (O == Op::SE_VX_VY) {
+        c.pc += (c.V[x] == c.V[y]) ? 4 : 2;
+    } else if constexpr (O == Op::LD_VX_NN) {
+        c.V[x] = d.nn();
+        c.pc += 2;
+    } else if constexpr (O == Op::ADD_VX_NN) {
+        c.V[x] += d.nn();
+        c.pc += 2;
+    } else if constexpr (O == Op::LD_VX_VY) {
+        c.V[x] = c.V[y];
+        c.pc += 2;
+    } else if constexpr (O == Op::OR) {
+        c.V[x] |= c.V[y];
+        c.pc += 2;
+    } else if constexpr (O == Op::AND) {
+        c.V[x] &= c.V[y];
+        c.pc += 2;
+    } else if constexpr (O == Op::XOR) {
+        c.V[x] ^= c.V[y];
+        c.pc += 2;
+    } else if constexpr (O == Op::ADD_VX_VY) {
+        uint16_t sum = c.V[x] + c.V[y];
+        c.V[0xF] = sum > 0xFF;
+        c.V[x] = sum & 0xFF;
+        c.pc += 2;
+    } else if constexpr (O == Op::SUB) {
+        c.V[0xF] = c.V[x] >= c.V[y];
+        c.V[x] -= c.V[y];
+        c.pc += 2;
+    } else if constexpr (O == Op::SHR) {
+        c.V[0xF] = c.V[x] & 0x01;
+        c.V[x] >>= 1;
+        c.pc += 2;
+    } else if constexpr (O == Op::SUBN) {
+        c.V[0xF] = c.V[y] >= c.V[x];
+        c.V[x] = c.V[y] - c.V[x];
+        c.pc += 2;
+    } else if constexpr (O == Op::SHL) {
+        c.V[0xF] = (c.V[x] & 0x80) >> 7;
+        c.V[x] <<= 1;
+        c.pc += 2;
+    } else if constexpr (O == Op::SNE_VX_VY) {
+        c.pc += (c.V[x] != c.V[y]) ? 4 : 2;
+    } else if constexpr (O == Op::LD_I) {
+        c.I = d.nnn;
+        c.pc += 2;
+    } else if constexpr (O == Op::JP_V0) {
+        c.pc = d.nnn + c.V[0];
+    } else if constexpr (O == Op::RND) {
+        c.V[x] = randomByte() & d.nn();
+        c.pc += 2;
+    } else if constexpr (O == Op::DRW) {
+        drawSprite(c, c.V, x, y, c.I, d.n);
+        c.draw_flag = true;
+        c.pc += 2;
+    } else if constexpr (O == Op::SKP) {
+        c.pc += c.keys[c.V[x]] ? 4 : 2;
+    } else if constexpr (O == Op::SKNP) {
+        c.pc += !c.keys[c.V[x]] ? 4 : 2;
+    } else if constexpr (O == Op::LD_VX_DT) {
+        c.V[x] = c.delayTimer;
+        c.pc += 2;
+    } else if constexpr (O == Op::LD_VX_K) {
+        for (int i = 0; i < NUM_KEYS; ++i) {
+            if (c.keys[i]) {
+                c.V[x] = i;
+                c.pc += 2;
+                c.key_wait = false;
+                return;
+            }
+        }
+        // No key held: leave pc on FX0A so it is retried
+        c.key_wait = true;
+    } else if constexpr (O == Op::LD_DT_VX) {
+        c.delayTimer = c.V[x];
+        c.pc += 2;
+    } else if constexpr (O == Op::LD_ST_VX) {
+        c.soundTimer = c.V[x];
+        c.pc += 2;
+    } else if constexpr (O == Op::ADD_I_VX) {
+        c.I += c.V[x];
+        c.pc += 2;
+    } else if constexpr (O == Op::LD_F_VX) {
+        c.I = c.V[x] * 5;
+        c.pc += 2;
+    } else if constexpr (O == Op::LD_B_VX) {
+        c.memory[c.I] = c.V[x] / 100;
+        c.memory[c.I + 1] = (c.V[x] / 10) % 10;
+        c.memory[c.I + 2] = c.V[x] % 10;
+        markWritten(c, c.I, 3);
+        c.pc += 2;
+    } else if constexpr (O == Op::LD_I_VX) {
+        for (int i = 0; i <= x; ++i)
+            c.memory[c.I + i] = c.V[i];
+        markWritten(c, c.I, x + 1);
+        c.pc += 2;
+    } else if constexpr (O == Op::LD_VX_I) {
+        for (int i = 0; i <= x; ++i)
+            c.V[i] = c.memory[c.I + i];
+        c.pc += 2;
+    }
+}
+
+
+// Executes one instruction whose opcode is known at compile time, so the
+// handler and all operand fields fold to constants.
+template <uint16_t OPCODE>
+inline void executeOpcode(Chip8 &c) {
+    constexpr Instr d = decode(OPCODE);
+    execute<d.op>(c, d);
+}
+
+
+// Executes one decoded instruction through a switch, for paths that
+// cannot use threaded dispatch (partial blocks, fallbacks).
+inline void executeInstr(Chip8 &c, const Instr &d) {
+    switch (d.op) {
+#define CHIP8_OP_CASE(name) \
+        case Op::name: execute<Op::name>(c, d); break;
+        CHIP8_OPS(CHIP8_OP_CASE)
+#undef CHIP8_OP_CASE
+        default: break;
+    }
+}
+
+
+#endif
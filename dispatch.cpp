@@ -0,0 +1,75 @@
+#include "cpu.hpp"
+#include "decode.hpp"
+
+#include <cstdint>
+
+
+// Flat-table interpreter. One table lookup replaces the nested family/ALU/MISC
+// switches of emulateCycle, and with GCC/Clang each handler ends in its own
+// indirect jump (computed goto), so the branch predictor sees one dispatch
+// site per handler instead of one shared site for every instruction.
+
+static inline Instr fetch(Chip8 &c) {
+    c.opcode = (c.memory[c.pc] << 8) | c.memory[c.pc + 1];
+    return decode(c.opcode);
+}
+
+
+uint32_t runTable(Chip8 &c, uint32_t budget) {
+    uint32_t done = 0;
+    Instr d;
+
+#if defined(__GNUC__)
+    static void *const handlers[NUM_OPS] = {
+#define CHIP8_OP_LABEL(name) __extension__ &&op_##name,
+        CHIP8_OPS(CHIP8_OP_LABEL)
+#undef CHIP8_OP_LABEL
+    };
+
+#define DISPATCH()                                                          \
+    do {                                                                    \
+        if (done == budget)                                                 \
+            return done;                                                    \
+        ++done;                                                             \
+        d = fetch(c);                                                       \
+        __extension__ ({ goto *handlers[static_cast<uint8_t>(d.op)]; });    \
+    } while (0)
+
+    DISPATCH();
+
+#define CHIP8_OP_HANDLER(name)                      \
+    op_##name:                                      \
+        execute<Op::name>(c, d);                    \
+        if constexpr (waitsForKey(Op::name))        \
+            if (c.key_wait)                         \
+                return done;                        \
+        DISPATCH();
+    CHIP8_OPS(CHIP8_OP_HANDLER)
+#undef CHIP8_OP_HANDLER
+#undef DISPATCH
+
+#else
+    while (done < budget) {
+        ++done;
+        d = fetch(c);
+        switch (d.op) {
+#define CHIP8_OP_CASE(name)                             \
+            case Op::name:                              \
+                execute<Op::name>(c, d);                \
+                if constexpr (waitsForKey(Op::name))    \
+                    if (c.key_wait)                     \
+                        return done;                    \
+                break;
+            CHIP8_OPS(CHIP8_OP_CASE)
+#undef CHIP8_OP_CASE
+            default: break;
+        }
+    }
+    return done;
+#endif
+}
+
+
+void emulateCycleTable(Chip8 &c) {
+    runTable(c, 1);
+}
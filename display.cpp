@@ -1,4 +1,7 @@
 #include "cpu.hpp"
+#include "emulator.hpp"
+#include "engine.hpp"
+#include "texture.hpp"
 
 #include <SDL2/SDL.h>
 #include <GL/gl.h>
@@ -6,19 +9,17 @@
 #include <backends/imgui_impl_sdl2.h>
 #include <backends/imgui_impl_opengl3.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <thread>
 
 
-void initialise(Chip8 &chip8);
-void emulateCycle(Chip8 &c);
-
-bool loadROM(std::string_view filename, Chip8 &chip8);
-
 static int mapSDLKey(SDL_Scancode sc) {
     switch (sc) {
         case SDL_SCANCODE_1: return 0x1;
@@ -42,19 +43,69 @@ static int mapSDLKey(SDL_Scancode sc) {
 }
 
 
-//  Upload chip8.gfx into an existing OpenGL texture
-static void uploadDisplay(Chip8 &chip8, GLuint tex) {
-    // Build an RGBA pixel buffer 
-    static uint32_t pixels[SCREEN_HEIGHT * SCREEN_WIDTH];
+// Moving averages shown in the debugger, to compare upload modes live,
+// plus emulated instructions and rendered frames per second, counted over
+// half-second windows so turbo speed can be compared across engines
+struct FrameStats {
+    double uploadUs = 0.0;
+    double frameMs = 0.0;
+
+    double mips = 0.0;
+    double fps = 0.0;
+    std::chrono::steady_clock::time_point window = std::chrono::steady_clock::now();
+    uint64_t windowInstructions = 0;
+    int windowFrames = 0;
+
+    // Key event arrival to the swap of the first frame emulated after it
+    double inputMs = 0.0;
+    double maxInputMs = 0.0;
+    SchedClock::time_point measuredInput;
+};
+
+
+// SDL stamps events in milliseconds since SDL_Init; map that onto the
+// scheduler's clock
+static SchedClock::time_point eventTime(Uint32 timestamp) {
+    Uint32 age = SDL_GetTicks() - timestamp;
+    return SchedClock::now() - std::chrono::milliseconds(age);
+}
+
+
+// Late sampling: runs the emulator up to now and waits for the frame,
+// giving up after a few milliseconds so a busy emulator cannot stall the UI
+static void waitForKick(Emulator &emu, Chip8 &view, uint32_t kick) {
+    auto giveUp = SchedClock::now() + std::chrono::milliseconds(4);
+    for (;;) {
+        latestFrame(emu, view);
+        if (static_cast<int32_t>(readSlot(emu.frames).kicks - kick) >= 0 || SchedClock::now() > giveUp)
+            return;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+
+// Front-end settings the debugger edits
+struct UiOptions {
+    bool powerSave = true;
+    float lateMarginMs = 4.0f;  // late sampling: emulate this long before vsync
+};
+
+static void addSample(double &avg, double sample) {
+    avg += (sample - avg) * 0.05;
+}
 
-    for (int y = 0; y < SCREEN_HEIGHT; ++y)
-        for (int x = 0; x < SCREEN_WIDTH; ++x)
-            pixels[y * SCREEN_WIDTH + x] = chip8.gfx[y][x] ? 0xFFFFFFFF : 0xFF000000;
 
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                 SCREEN_WIDTH, SCREEN_HEIGHT,
-                 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+static void countFrame(FrameStats &stats, uint64_t instructions) {
+    auto now = std::chrono::steady_clock::now();
+    ++stats.windowFrames;
+    double elapsed = std::chrono::duration<double>(now - stats.window).count();
+    if (elapsed < 0.5)
+        return;
+    stats.mips = (instructions - stats.windowInstructions) / elapsed / 1e6;
+    stats.fps = stats.windowFrames / elapsed;
+    stats.window = now;
+    stats.windowInstructions = instructions;
+    stats.windowFrames = 0;
 }
 
 
@@ -73,10 +124,83 @@ static void renderDisplayWindow(GLuint tex) {
 }
 
 
-static void renderDebugWindow(const Chip8 &c) {
+static void renderDebugWindow(const Chip8 &c, Emulator &emu, DisplayTexture &display,
+                              const FrameStats &stats, UiOptions &options) {
     ImGui::SetNextWindowSize(ImVec2(X_MAIN_WINDOW_SIZE, Y_MAIN_WINDOW_SIZE), ImGuiCond_FirstUseEver);
     ImGui::Begin("Debugger");
 
+    // The switch takes effect on the emulator thread's next tick
+    Engine current = readSlot(emu.frames).engine;
+    if (ImGui::BeginCombo("Engine", engineName(current))) {
+        for (int i = 0; i < static_cast<int>(Engine::COUNT); ++i) {
+            Engine e = static_cast<Engine>(i);
+            if (ImGui::Selectable(engineName(e), e == current))
+                sendInput(emu, { InputEvent::SetEngine, static_cast<uint32_t>(e) });
+        }
+        ImGui::EndCombo();
+    }
+
+    static const uint32_t IPS_CHOICES[] = { 500, 1000, 10000 };
+    const Frame &frame = readSlot(emu.frames);
+    char ipsLabel[16];
+    std::snprintf(ipsLabel, sizeof(ipsLabel), "%u", frame.ips);
+    if (ImGui::BeginCombo("IPS", ipsLabel)) {
+        for (uint32_t ips : IPS_CHOICES) {
+            std::snprintf(ipsLabel, sizeof(ipsLabel), "%u", ips);
+            if (ImGui::Selectable(ipsLabel, ips == frame.ips))
+                sendInput(emu, { InputEvent::SetIps, ips });
+        }
+        ImGui::EndCombo();
+    }
+    bool turbo = frame.turbo;
+    if (ImGui::Checkbox("Turbo", &turbo))
+        sendInput(emu, { InputEvent::SetTurbo, turbo });
+    ImGui::SameLine();
+    ImGui::Checkbox("Power save", &options.powerSave);
+    bool late = frame.lateSampling;
+    if (ImGui::Checkbox("Late input", &late))
+        sendInput(emu, { InputEvent::SetLateSampling, late });
+    if (late) {
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(100);
+        ImGui::SliderFloat("margin ms", &options.lateMarginMs, 1.0f, 12.0f, "%.1f");
+    }
+    ImGui::Text("Input latency %.1f ms (max %.1f)", stats.inputMs, stats.maxInputMs);
+    ImGui::Text("%.2f MIPS  %.0f FPS", stats.mips, stats.fps);
+    ImGui::Text("Timers %.2f Hz  Drift %+.3f ms", frame.sched.timerHz, frame.sched.driftMs);
+    ImGui::Text("Lag %.2f ms (max %.2f)  Lost %.0f ms",
+                frame.sched.lagMs, frame.sched.maxLagMs, frame.sched.lostMs);
+
+    if (ImGui::BeginCombo("Upload", uploadModeName(display.mode))) {
+        for (int i = 0; i < static_cast<int>(UploadMode::COUNT); ++i) {
+            UploadMode m = static_cast<UploadMode>(i);
+            if (ImGui::Selectable(uploadModeName(m), m == display.mode))
+                display.mode = m;
+        }
+        ImGui::EndCombo();
+    }
+
+    if (ImGui::BeginCombo("Format", textureFormatName(display.format))) {
+        for (int i = 0; i < static_cast<int>(TextureFormat::COUNT); ++i) {
+            TextureFormat f = static_cast<TextureFormat>(i);
+            if (ImGui::Selectable(textureFormatName(f), f == display.format))
+                setTextureFormat(display, f);
+        }
+        ImGui::EndCombo();
+    }
+
+    static const char *PALETTE_LABELS[] = { "Off", "On" };
+    for (int i = 0; i < 2; ++i) {
+        ImVec4 color = ImGui::ColorConvertU32ToFloat4(display.palette[i]);
+        if (ImGui::ColorEdit3(PALETTE_LABELS[i], &color.x, ImGuiColorEditFlags_NoInputs)) {
+            color.w = 1.0f;
+            setPaletteColor(display, i, ImGui::ColorConvertFloat4ToU32(color));
+        }
+        if (i == 0)
+            ImGui::SameLine();
+    }
+    ImGui::Text("Upload %.1f us  Frame %.2f ms", stats.uploadUs, stats.frameMs);
+
     if (ImGui::CollapsingHeader("Registers", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Columns(4, "regs", true);
         for (int i = 0; i < NUM_REGISTERS; ++i) {
@@ -130,17 +254,38 @@ static void renderDebugWindow(const Chip8 &c) {
 }
 
 
-int main() {
-    Chip8 chip8;
-    initialise(chip8);
+int main(int argc, char **argv) {
+    // Runs on its own thread; the UI only sees the frames it publishes
+    static Emulator emu;
+    initialise(emu.chip8);
+    selectEngine(emu.core, Engine::Switch);
 
     std::string romPath;
     std::cout << "Enter path to ROM: ";
     std::getline(std::cin, romPath);
 
-    if (!loadROM(romPath, chip8))
+    if (!loadROM(romPath, emu.chip8))
         return 1;
 
+    // --export NAME also publishes every frame to a shared-memory ring
+    // that other processes can read (shmring.hpp); --export-replace takes
+    // the name over from a ring left by another (or a crashed) writer
+    std::string exportName;
+    bool exportReplace = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--export" && i + 1 < argc && exportName.empty())
+            exportName = argv[++i];
+        else if (arg == "--export-replace")
+            exportReplace = true;
+    }
+    static RingWriter exportRing;
+    if (!exportName.empty()) {
+        if (!openRingWriter(exportRing, exportName, 256, exportReplace))
+            return 1;
+        emu.exportRing = &exportRing;
+    }
+
     SDL_Init(SDL_INIT_VIDEO);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
@@ -154,12 +299,13 @@ int main() {
     SDL_GLContext glCtx = SDL_GL_CreateContext(win);
     SDL_GL_SetSwapInterval(1); // vsync
 
-    GLuint displayTex = 0;
-    glGenTextures(1, &displayTex);
-    glBindTexture(GL_TEXTURE_2D, displayTex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    uploadDisplay(chip8, displayTex); // blank frame to start
+    // The UI's copy of the machine, refreshed from each new frame
+    Chip8 view;
+    initialise(view);
+
+    DisplayTexture display;
+    createDisplayTexture(display);
+    uploadDisplay(display, view); // blank frame to start
 
  
     IMGUI_CHECKVERSION();
@@ -169,45 +315,90 @@ int main() {
     ImGui_ImplSDL2_InitForOpenGL(win, glCtx);
     ImGui_ImplOpenGL3_Init("#version 130");
 
+    // Power save: the emulator thread posts wakeEvent when the machine
+    // changes, and the loop sleeps in SDL_WaitEventTimeout until that,
+    // input or the next stats refresh, skipping the ImGui rebuild and swap
+    // when none of them happened
+    static Uint32 wakeEvent = SDL_RegisterEvents(1);
+    UiOptions options;
+    options.powerSave = wakeEvent != static_cast<Uint32>(-1);
+    if (options.powerSave) {
+        emu.onChange = [](void *) {
+            SDL_Event wake{};
+            wake.type = wakeEvent;
+            SDL_PushEvent(&wake);
+        };
+    }
+
+    startEmulator(emu);
+
     // Timing
-    using Clock = std::chrono::high_resolution_clock;
-    auto lastTimer = Clock::now();
+    using Clock = SchedClock;
+    constexpr auto STATS_REFRESH = std::chrono::seconds(1);
+    auto lastFrame = Clock::now();
+    auto vsyncPeriod = std::chrono::duration<double>(1.0 / 60);
+    FrameStats stats;
+    Frame rendered{};
+    int settleFrames = 0;   // ImGui needs a frame or two to react to input
 
     bool running = true;
     while (running) {
+        bool late = readSlot(emu.frames).lateSampling && !readSlot(emu.frames).turbo;
+
+        // Late sampling: hold off until just before the next vsync so the
+        // input read below is as fresh as possible when the frame shows
+        if (late) {
+            auto margin = std::chrono::duration<double, std::milli>(options.lateMarginMs);
+            std::this_thread::sleep_until(lastFrame + std::chrono::duration_cast<Clock::duration>(
+                vsyncPeriod - margin));
+        }
 
         SDL_Event e;
-        while (SDL_PollEvent(&e)) {
+        bool pending;
+        if (options.powerSave && !late && settleFrames == 0) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                lastFrame + STATS_REFRESH - Clock::now()).count();
+            pending = SDL_WaitEventTimeout(&e, wait > 0 ? static_cast<int>(wait) : 0) != 0;
+        } else {
+            pending = SDL_PollEvent(&e) != 0;
+        }
+
+        for (; pending; pending = SDL_PollEvent(&e) != 0) {
+            if (e.type == wakeEvent)
+                continue;
             ImGui_ImplSDL2_ProcessEvent(&e);
+            settleFrames = 2;
 
             if (e.type == SDL_QUIT)
                 running = false;
 
-            if (e.type == SDL_KEYDOWN) {
-                int k = mapSDLKey(e.key.keysym.scancode);
-                if (k >= 0) chip8.keys[k] = true;
-            }
-            if (e.type == SDL_KEYUP) {
+            if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && !e.key.repeat) {
                 int k = mapSDLKey(e.key.keysym.scancode);
-                if (k >= 0) chip8.keys[k] = false;
+                if (k >= 0)
+                    sendInput(emu, { e.type == SDL_KEYDOWN ? InputEvent::KeyDown : InputEvent::KeyUp,
+                                     static_cast<uint32_t>(k), eventTime(e.key.timestamp) });
             }
         }
 
-        // Emulate several cycles per frame (~500 Hz at 60fps)
-        for (int i = 0; i < 8; ++i)
-            emulateCycle(chip8);
-
-        auto now = Clock::now();
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(
-                now - lastTimer).count() >= 16) {
-            if (chip8.delayTimer > 0) --chip8.delayTimer;
-            if (chip8.soundTimer > 0) --chip8.soundTimer;
-            lastTimer = now;
-        }
-
-        if (chip8.draw_flag) {
-            uploadDisplay(chip8, displayTex);
-            chip8.draw_flag = false;
+        if (late)
+            waitForKick(emu, view, kickEmulator(emu));
+        else
+            latestFrame(emu, view);
+        const Frame &frame = readSlot(emu.frames);
+        bool changed = !sameMachineState(frame, rendered);
+        if (options.powerSave && !late && !changed && settleFrames == 0 && !display.repaint &&
+            Clock::now() - lastFrame < STATS_REFRESH)
+            continue;
+        rendered = frame;
+        if (settleFrames > 0)
+            --settleFrames;
+
+        countFrame(stats, frame.instructions);
+        if (view.dirty_rows || display.repaint) {
+            auto uploadStart = Clock::now();
+            uploadDisplay(display, view);
+            addSample(stats.uploadUs, std::chrono::duration<double, std::micro>(
+                Clock::now() - uploadStart).count());
         }
 
 
@@ -215,8 +406,8 @@ int main() {
         ImGui_ImplSDL2_NewFrame();
         ImGui::NewFrame();
 
-        renderDisplayWindow(displayTex);
-        renderDebugWindow(chip8);
+        renderDisplayWindow(display.tex);
+        renderDebugWindow(view, emu, display, stats, options);
 
         ImGui::Render();
         int w, h;
@@ -226,13 +417,29 @@ int main() {
         glClear(GL_COLOR_BUFFER_BIT);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         SDL_GL_SwapWindow(win);
+
+        auto frameEnd = Clock::now();
+        addSample(stats.frameMs, std::chrono::duration<double, std::milli>(
+            frameEnd - lastFrame).count());
+        if (frameEnd - lastFrame < std::chrono::milliseconds(50))
+            vsyncPeriod += (frameEnd - lastFrame - vsyncPeriod) * 0.05;
+        lastFrame = frameEnd;
+
+        if (rendered.lastInput != stats.measuredInput) {
+            stats.measuredInput = rendered.lastInput;
+            double ms = std::chrono::duration<double, std::milli>(frameEnd - rendered.lastInput).count();
+            addSample(stats.inputMs, ms);
+            stats.maxInputMs = std::max(stats.maxInputMs, ms);
+        }
     }
 
     // Cleanup
+    stopEmulator(emu);
+    closeRingWriter(exportRing);
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
-    glDeleteTextures(1, &displayTex);
+    destroyDisplayTexture(display);
     SDL_GL_DeleteContext(glCtx);
     SDL_DestroyWindow(win);
     SDL_Quit();
@@ -0,0 +1,197 @@
+#include "emulator.hpp"
+
+#include <cstring>
+#include <ctime>
+#include <functional>
+
+
+static void applyInput(Emulator &emu, const InputEvent &event) {
+    switch (event.kind) {
+        case InputEvent::KeyDown:
+        case InputEvent::KeyUp:
+            emu.chip8.keys[event.value & 0xF] = event.kind == InputEvent::KeyDown;
+            emu.lastInput = event.at;
+            break;
+        case InputEvent::SetEngine:
+            if (event.value < static_cast<uint8_t>(Engine::COUNT))
+                selectEngine(emu.core, static_cast<Engine>(event.value));
+            break;
+        case InputEvent::SetIps:
+            resetScheduler(emu.sched, event.value, SchedClock::now());
+            break;
+        case InputEvent::SetTurbo:
+            emu.turbo = event.value != 0;
+            break;
+        case InputEvent::SetLateSampling:
+            emu.lateSampling = event.value != 0;
+            break;
+    }
+}
+
+
+bool sameMachineState(const Frame &a, const Frame &b) {
+    return std::memcmp(a.gfx, b.gfx, sizeof(a.gfx)) == 0 &&
+           std::memcmp(a.V, b.V, sizeof(a.V)) == 0 &&
+           std::memcmp(a.stack, b.stack, sizeof(a.stack)) == 0 &&
+           std::memcmp(a.keys, b.keys, sizeof(a.keys)) == 0 &&
+           a.I == b.I && a.pc == b.pc && a.sp == b.sp &&
+           a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer &&
+           a.opcode == b.opcode && a.key_wait == b.key_wait &&
+           a.engine == b.engine && a.ips == b.ips && a.turbo == b.turbo &&
+           a.lateSampling == b.lateSampling;
+}
+
+
+static void publishFrame(Emulator &emu, uint64_t instructions) {
+    const Chip8 &c = emu.chip8;
+    Frame &f = writeSlot(emu.frames);
+    std::memcpy(f.gfx, c.gfx, sizeof(f.gfx));
+    std::memcpy(f.V, c.V, sizeof(f.V));
+    std::memcpy(f.stack, c.stack, sizeof(f.stack));
+    std::memcpy(f.keys, c.keys, sizeof(f.keys));
+    f.I = c.I;
+    f.pc = c.pc;
+    f.sp = c.sp;
+    f.delayTimer = c.delayTimer;
+    f.soundTimer = c.soundTimer;
+    f.opcode = c.opcode;
+    f.key_wait = c.key_wait;
+    f.engine = emu.core.engine;
+    f.instructions = instructions;
+    f.ips = emu.sched.ips;
+    f.turbo = emu.turbo;
+    f.lateSampling = emu.lateSampling;
+    f.lastInput = emu.lastInput;
+    f.kicks = emu.kicksSeen;
+    f.sched = emu.sched.stats;
+
+    bool changed = !sameMachineState(f, emu.lastPublished);
+    if (changed)
+        emu.lastPublished = f;
+    publish(emu.frames);
+    if (emu.exportRing)
+        exportFrame(*emu.exportRing, c, instructions);
+    if (changed && emu.onChange)
+        emu.onChange(emu.onChangeCtx);
+}
+
+
+// Applies queued events, first running each key event's share of
+// emulated time so it lands on the instruction matching its arrival.
+// Returns the instructions executed.
+static uint64_t deliverInput(Emulator &emu) {
+    uint64_t executed = 0;
+    InputEvent event;
+    while (pop(emu.input, event)) {
+        bool key = event.kind == InputEvent::KeyDown || event.kind == InputEvent::KeyUp;
+        if (key && !emu.turbo)
+            executed += runTo(emu.sched, emu.chip8, emu.core, event.at);
+        applyInput(emu, event);
+    }
+    return executed;
+}
+
+
+// Sleeps until deadline or a kick, whichever is first
+static void sleepUntil(Emulator &emu, SchedClock::time_point deadline) {
+    std::unique_lock lock(emu.wakeMutex);
+    emu.wake.wait_until(lock, deadline, [&] {
+        return emu.kicks != emu.kicksSeen || emu.quit.load(std::memory_order_relaxed);
+    });
+    emu.kicksSeen = emu.kicks;
+}
+
+
+static void run(Emulator &emu) {
+    constexpr auto PUBLISH_INTERVAL = std::chrono::nanoseconds(1'000'000'000 / Emulator::TURBO_PUBLISH_HZ);
+
+    Chip8 &c = emu.chip8;
+    uint64_t instructions = 0;
+    // The random stream is per thread; initialise seeded the caller's
+    seedRandom(static_cast<unsigned>(std::time(nullptr)));
+    resetScheduler(emu.sched, emu.ips, SchedClock::now());
+    auto nextPublish = SchedClock::now();
+    while (!emu.quit.load(std::memory_order_relaxed)) {
+        instructions += deliverInput(emu);
+
+        if (emu.turbo)
+            instructions += runTurbo(emu.sched, c, emu.core, Emulator::TURBO_BATCH);
+        else
+            instructions += runUntil(emu.sched, c, emu.core, SchedClock::now());
+
+        // The UI diffs frames itself, so nothing consumes these here
+        c.draw_flag = false;
+        c.dirty_rows = 0;
+
+        if (!emu.turbo) {
+            publishFrame(emu, instructions);
+            sleepUntil(emu, emu.lateSampling ? SchedClock::now() + Emulator::LATE_FALLBACK
+                                             : nextTimerTick(emu.sched));
+        } else if (auto now = SchedClock::now(); now >= nextPublish) {
+            publishFrame(emu, instructions);
+            nextPublish = now + PUBLISH_INTERVAL;
+        }
+    }
+}
+
+
+void startEmulator(Emulator &emu) {
+    emu.quit.store(false);
+    publishFrame(emu, 0);
+    emu.thread = std::thread(run, std::ref(emu));
+}
+
+
+void stopEmulator(Emulator &emu) {
+    {
+        std::lock_guard lock(emu.wakeMutex);
+        emu.quit.store(true);
+    }
+    emu.wake.notify_one();
+    if (emu.thread.joinable())
+        emu.thread.join();
+    releaseJitCache(emu.core.jit);
+}
+
+
+void sendInput(Emulator &emu, InputEvent event) {
+    // The thread pops every queued event as soon as it wakes
+    while (!push(emu.input, event)) {
+        kickEmulator(emu);
+        std::this_thread::yield();
+    }
+}
+
+
+uint32_t kickEmulator(Emulator &emu) {
+    uint32_t kick;
+    {
+        std::lock_guard lock(emu.wakeMutex);
+        kick = ++emu.kicks;
+    }
+    emu.wake.notify_one();
+    return kick;
+}
+
+
+bool latestFrame(Emulator &emu, Chip8 &view) {
+    if (!take(emu.frames))
+        return false;
+
+    const Frame &f = readSlot(emu.frames);
+    for (int y = 0; y < SCREEN_HEIGHT; ++y)
+        if (view.gfx[y] != f.gfx[y])
+            view.dirty_rows |= uint32_t{1} << y;
+    std::memcpy(view.gfx, f.gfx, sizeof(view.gfx));
+    std::memcpy(view.V, f.V, sizeof(view.V));
+    std::memcpy(view.stack, f.stack, sizeof(view.stack));
+    std::memcpy(view.keys, f.keys, sizeof(view.keys));
+    view.I = f.I;
+    view.pc = f.pc;
+    view.sp = f.sp;
+    view.delayTimer = f.delayTimer;
+    view.soundTimer = f.soundTimer;
+    view.opcode = f.opcode;
+    view.key_wait = f.key_wait;
+    return true;
+}
@@ -0,0 +1,116 @@
+#ifndef EMULATOR_HPP
+#define EMULATOR_HPP
+
+#include "cpu.hpp"
+#include "engine.hpp"
+#include "handoff.hpp"
+#include "scheduler.hpp"
+#include "shmring.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// What the UI needs from the machine after a tick: the screen and the
+// state the debugger shows.
+struct Frame {
+    uint64_t gfx[SCREEN_HEIGHT];
+    uint8_t V[NUM_REGISTERS];
+    uint16_t I;
+    uint16_t pc;
+    uint16_t stack[STACK_SIZE];
+    uint8_t sp;
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+    bool keys[NUM_KEYS];
+    uint16_t opcode;
+    bool key_wait;
+    Engine engine;
+    uint64_t instructions;      // executed since start
+    uint32_t ips;
+    bool turbo;
+    bool lateSampling;
+    SchedulerStats sched;
+    SchedClock::time_point lastInput;   // arrival of the newest key event applied
+    uint32_t kicks;                     // kickEmulator calls seen
+};
+
+// UI -> emulator messages. Key events reach Chip8::keys at the emulated
+// instruction matching at, their arrival time, even though the thread only
+// sees them at its next wake; the rest apply before the next run.
+struct InputEvent {
+    enum Kind : uint8_t { KeyDown, KeyUp, SetEngine, SetIps, SetTurbo, SetLateSampling } kind;
+    uint32_t value;             // key index, Engine, instructions per second or on/off
+    SchedClock::time_point at = {};
+};
+
+// A Chip8 running on its own thread, independent of how fast the UI
+// renders. The thread wakes at every timer tick, runs what the scheduler
+// says is due and publishes a Frame. In turbo it never sleeps: it runs
+// TURBO_BATCH instructions at a time and publishes at most TURBO_PUBLISH_HZ
+// frames per second, since the UI only shows one per display refresh
+// anyway.
+// With late sampling the thread does not wake on timer ticks but when the
+// UI calls kickEmulator just before vsync, so each displayed frame is
+// emulated with the newest input; LATE_FALLBACK keeps it running if the UI
+// stops kicking. Large, so keep it static or on the heap.
+struct Emulator {
+    static constexpr uint64_t TURBO_BATCH = 4096;
+    static constexpr int TURBO_PUBLISH_HZ = 240;
+    static constexpr auto LATE_FALLBACK = std::chrono::milliseconds(100);
+
+    Chip8 chip8;                // owned by the emulator thread once started
+    Core core;
+    Scheduler sched;
+    uint32_t ips = DEFAULT_IPS;
+    bool turbo = false;
+    bool lateSampling = false;
+    SchedClock::time_point lastInput;
+
+    // Called on the emulator thread after publishing a frame whose machine
+    // state differs from the previous one, so a UI can sleep until then.
+    // Set before startEmulator.
+    void (*onChange)(void *ctx) = nullptr;
+    void *onChangeCtx = nullptr;
+    Frame lastPublished = {};
+    TripleBuffer<Frame> frames;
+
+    // If set before startEmulator, every published frame is also exported
+    // to this shared-memory ring, from the emulator thread
+    RingWriter *exportRing = nullptr;
+    SpscQueue<InputEvent, 256> input;
+    std::atomic<bool> quit{false};
+    std::thread thread;
+
+    std::mutex wakeMutex;       // only guards sleeping and the kick count
+    std::condition_variable wake;
+    uint32_t kicks = 0;
+    uint32_t kicksSeen = 0;
+};
+
+// True if a and b show the same machine and settings; counters and
+// scheduler stats are ignored.
+bool sameMachineState(const Frame &a, const Frame &b);
+
+// chip8 must be initialised and loaded; core.engine selects the engine.
+void startEmulator(Emulator &emu);
+void stopEmulator(Emulator &emu);
+
+// Never drops an event: if the queue is full, kicks the thread so it
+// drains the queue and retries, so a KeyUp can never be lost and leave a
+// key held down.
+void sendInput(Emulator &emu, InputEvent event);
+
+// Wakes the thread to run everything due now and publish. Returns the
+// kick number; the first Frame with kicks at least that reflects it.
+uint32_t kickEmulator(Emulator &emu);
+
+// Copies the newest published frame into view, marking the rows that
+// differ from what view held in view.dirty_rows. Returns false if nothing
+// new was published since the last call.
+bool latestFrame(Emulator &emu, Chip8 &view);
+
+
+#endif
@@ -0,0 +1,67 @@
+#include "engine.hpp"
+#include "decode.hpp"
+
+#include <cstdint>
+
+
+const char *engineName(Engine e) {
+    switch (e) {
+        case Engine::Switch:      return "switch";
+        case Engine::Table:       return "table";
+        case Engine::Specialized: return "specialized";
+        case Engine::Cached:      return "cached";
+        case Engine::Block:       return "block";
+        case Engine::Jit:         return "jit";
+        case Engine::Cycles:      return "cycles";
+        default:                  return "?";
+    }
+}
+
+
+void selectEngine(Core &core, Engine e) {
+    core.engine = e;
+    resetDecodeCache(core.decode);
+    resetBlockCache(core.blocks);
+    resetJitCache(core.jit);
+}
+
+
+uint32_t runCore(Chip8 &c, Core &core, uint32_t budget) {
+    if (blockedOnKey(c))
+        return 0;
+    if (uint32_t skipped = skipIdleLoop(c, budget))
+        return skipped;
+
+    switch (core.engine) {
+        case Engine::Switch:
+            for (uint32_t i = 0; i < budget; ++i) {
+                emulateCycle(c);
+                if (c.key_wait)
+                    return i + 1;
+            }
+            return budget;
+        case Engine::Table:
+            return runTable(c, budget);
+        case Engine::Specialized:
+            return runSpecialized(c, budget);
+        case Engine::Cached:
+            return runCached(c, core.decode, budget);
+        case Engine::Block:
+            return runBlocks(c, core.blocks, budget);
+        case Engine::Jit:
+            return runJit(c, core.jit, budget);
+        case Engine::Cycles: {
+            // Draws and invalid opcodes only pause a batch; keep going
+            uint32_t done = 0;
+            while (done < budget) {
+                RunResult r = runCycles(c, budget - done);
+                done += r.cycles;
+                if (r.reason == StopReason::KeyWait)
+                    break;
+            }
+            return done;
+        }
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include "cpu.hpp"
+#include "predecode.hpp"
+#include "blocks.hpp"
+#include "jit.hpp"
+
+#include <cstdint>
+
+// Interpreter engines a front end can drive a Chip8 with. All of them
+// produce the same machine state as emulateCycle.
+enum class Engine : uint8_t {
+    Switch,        // emulateCycle
+    Table,         // flat handler table (dispatch.cpp)
+    Specialized,   // 64K per-opcode handler table (specialized.cpp)
+    Cached,        // predecoded per-address cache (predecode.cpp)
+    Block,         // basic-block translation cache (blocks.cpp)
+    Jit,           // x86-64 dynamic recompiler (jit.cpp)
+    Cycles,        // batched runCycles with state in locals (cycles.cpp)
+    COUNT
+};
+
+const char *engineName(Engine e);
+
+// An engine choice plus the caches it needs. Large, so keep it static or
+// on the heap rather than on the stack.
+struct Core {
+    Engine engine;
+    DecodeCache decode;
+    BlockCache blocks;
+    JitCache jit;
+};
+
+// Switches engine and drops all cached code.
+void selectEngine(Core &core, Engine e);
+
+// Runs up to budget instructions, returns the number executed.
+uint32_t runCore(Chip8 &c, Core &core, uint32_t budget);
+
+
+#endif
@@ -0,0 +1,102 @@
+#include "env.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+
+
+// Eight pixels of a row as eight plane bytes, leftmost pixel first
+static constexpr std::array<std::array<uint8_t, 8>, 256> PLANE_BYTES = [] {
+    std::array<std::array<uint8_t, 8>, 256> table{};
+    for (int b = 0; b < 256; ++b)
+        for (int i = 0; i < 8; ++i)
+            table[b][i] = (b & (0x80 >> i)) ? 0xFF : 0x00;
+    return table;
+}();
+
+
+static void expandRows(VecEnv &env, int lane, uint32_t rows) {
+    const uint64_t *gfx = &env.batch.gfx[lane * SCREEN_HEIGHT];
+    uint8_t *plane = &env.planes[static_cast<size_t>(lane) * SCREEN_HEIGHT * SCREEN_WIDTH];
+    for (; rows; rows &= rows - 1) {
+        int y = std::countr_zero(rows);
+        uint8_t *out = plane + y * SCREEN_WIDTH;
+        for (int i = 0; i < SCREEN_WIDTH / 8; ++i)
+            std::memcpy(out + 8 * i, PLANE_BYTES[(gfx[y] >> (56 - 8 * i)) & 0xFF].data(), 8);
+    }
+    env.batch.dirty_rows[lane] = 0;
+}
+
+
+void createEnv(VecEnv &env, const Chip8 &image, const EnvConfig &config) {
+    env.config = config;
+    if (env.config.actionKeys.empty()) {
+        env.config.actionKeys.push_back(0);
+        for (int k = 0; k < NUM_KEYS; ++k)
+            env.config.actionKeys.push_back(static_cast<uint16_t>(1u << k));
+    }
+    env.image = image;
+    resetBatch(env.batch, config.lanes, image);
+    env.frames.assign(config.lanes, 0);
+    if (config.obs == ObsFormat::Planes)
+        env.planes.assign(static_cast<size_t>(config.lanes) * SCREEN_HEIGHT * SCREEN_WIDTH, 0);
+    else
+        env.planes.clear();
+    resetEnv(env, 1);
+}
+
+
+void resetEnv(VecEnv &env, unsigned seed) {
+    seedRandom(seed);
+    for (int l = 0; l < env.config.lanes; ++l)
+        resetEnvLane(env, l);
+}
+
+
+void resetEnvLane(VecEnv &env, int lane) {
+    setLane(env.batch, lane, env.image);
+    env.frames[lane] = 0;
+    if (env.config.obs == ObsFormat::Planes)
+        expandRows(env, lane, ~uint32_t{0});
+}
+
+
+void stepEnv(VecEnv &env, const int *actions) {
+    Batch &b = env.batch;
+    const EnvConfig &config = env.config;
+    for (int l = 0; l < config.lanes; ++l)
+        b.keys[l] = config.actionKeys[actions[l]];
+
+    for (int f = 0; f < config.frameSkip; ++f) {
+        runBatch(b, config.cyclesPerFrame);
+        tickBatchTimers(b);
+    }
+    for (int l = 0; l < config.lanes; ++l)
+        env.frames[l] += config.frameSkip;
+
+    // Planes follow the rows DXYN and 00E0 marked; most lanes redraw a
+    // few rows per step
+    if (config.obs == ObsFormat::Planes)
+        for (int l = 0; l < config.lanes; ++l)
+            if (b.dirty_rows[l])
+                expandRows(env, l, b.dirty_rows[l]);
+}
+
+
+int actionCount(const VecEnv &env) {
+    return static_cast<int>(env.config.actionKeys.size());
+}
+
+
+const void *observations(const VecEnv &env) {
+    if (env.config.obs == ObsFormat::Planes)
+        return env.planes.data();
+    return env.batch.gfx.data();
+}
+
+
+size_t observationSize(const VecEnv &env) {
+    if (env.config.obs == ObsFormat::Planes)
+        return SCREEN_HEIGHT * SCREEN_WIDTH;
+    return SCREEN_HEIGHT * sizeof(uint64_t);
+}
@@ -0,0 +1,69 @@
+#ifndef ENV_HPP
+#define ENV_HPP
+
+#include "batch.hpp"
+#include "cpu.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Vectorized environment for reinforcement learning: many copies of one
+// ROM stepped together on a Batch. An action is an index into a table of
+// key sets; stepEnv holds each lane's keys for frameSkip frames of
+// cyclesPerFrame instructions, ticking the timers once per frame, then
+// leaves the final screens in the observation buffer.
+//
+// The observation buffer is allocated once and never moves, so a caller
+// can wrap it (a numpy array, a tensor) once and read it after every
+// step. Bits observations are the batch's own screen rows, no copy at
+// all. Planes observations expand only the rows each lane redrew.
+
+enum class ObsFormat {
+    Bits,      // lanes x SCREEN_HEIGHT uint64_t rows, Chip8::gfx layout (x = 0 is bit 63)
+    Planes,    // lanes x SCREEN_HEIGHT x SCREEN_WIDTH bytes, 0 or 255
+};
+
+struct EnvConfig {
+    int lanes = 256;
+    int frameSkip = 4;
+    uint32_t cyclesPerFrame = 8;
+    ObsFormat obs = ObsFormat::Bits;
+
+    // Keys held for each action, bit k for key k. Empty means 17 actions:
+    // no key, then each key 0..F alone.
+    std::vector<uint16_t> actionKeys;
+};
+
+struct VecEnv {
+    EnvConfig config;
+    Chip8 image;                     // the state reset returns a lane to
+    Batch batch;
+    std::vector<uint8_t> planes;     // ObsFormat::Planes only
+    std::vector<uint32_t> frames;    // frames since the lane was last reset
+};
+
+// Allocates every buffer and resets every lane to image (initialised and
+// loaded).
+void createEnv(VecEnv &env, const Chip8 &image, const EnvConfig &config);
+
+// Returns every lane to the image and seeds the random stream CXNN draws
+// from. Steps run on the calling thread's stream.
+void resetEnv(VecEnv &env, unsigned seed);
+
+// Returns one lane to the image, e.g. at the end of its episode.
+void resetEnvLane(VecEnv &env, int lane);
+
+// actions holds one entry per lane, each below actionCount(env).
+void stepEnv(VecEnv &env, const int *actions);
+
+int actionCount(const VecEnv &env);
+
+// The observation buffer: lanes observations of observationSize(env)
+// bytes each, contiguous. The pointer stays valid until createEnv is
+// called again.
+const void *observations(const VecEnv &env);
+size_t observationSize(const VecEnv &env);
+
+
+#endif
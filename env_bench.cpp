@@ -0,0 +1,174 @@
+#include "cpu.hpp"
+#include "env.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// Environment check and benchmark: steps a VecEnv with pseudo-random
+// actions, resetting each lane at the end of its episode, and compares
+// every observation with a Chip8 per lane run through emulateCycle. Then
+// times stepEnv alone.
+//
+//   ./env_bench [--lanes N] [--steps N] [--skip N] [--cycles N]
+//               [--episode N] [--keys K,K,...] [--planes] [--no-verify] [rom]
+//
+// --keys limits the actions to no key plus the listed hex keys, e.g.
+// --keys 1,4 for PONG's left paddle. --episode resets a lane every N of
+// its steps, staggered across lanes.
+
+struct Options {
+    EnvConfig config;
+    long steps = 1000;
+    long episode = 0;
+    bool verify = true;
+};
+
+
+static int action(const VecEnv &env, int lane, long step) {
+    uint32_t h = static_cast<uint32_t>(lane) * 0x9E3779B1u ^ static_cast<uint32_t>(step / 4) * 0x85EBCA6Bu;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return static_cast<int>(h % static_cast<uint32_t>(actionCount(env)));
+}
+
+static bool endOfEpisode(const Options &o, int lane, long step) {
+    return o.episode > 0 && (step + lane) % o.episode == 0;
+}
+
+
+static void tickTimers(Chip8 &c) {
+    if (c.delayTimer > 0) --c.delayTimer;
+    if (c.soundTimer > 0) --c.soundTimer;
+}
+
+
+static bool sameObservation(const VecEnv &env, int lane, const Chip8 &c) {
+    const uint8_t *obs = static_cast<const uint8_t *>(observations(env)) + lane * observationSize(env);
+    if (env.config.obs == ObsFormat::Bits)
+        return std::memcmp(obs, c.gfx, sizeof(c.gfx)) == 0;
+    for (int y = 0; y < SCREEN_HEIGHT; ++y)
+        for (int x = 0; x < SCREEN_WIDTH; ++x)
+            if ((obs[y * SCREEN_WIDTH + x] != 0) != pixelAt(c, x, y))
+                return false;
+    return true;
+}
+
+
+// The batch draws random numbers one lane at a time in lane order, so the
+// reference runs one instruction on each machine in turn
+static int verify(const Chip8 &image, const Options &o) {
+    static VecEnv env;
+    createEnv(env, image, o.config);
+    const int lanes = o.config.lanes;
+    std::vector<Chip8> reference(lanes, image);
+    std::vector<int> actions(lanes);
+
+    for (long s = 0; s < o.steps; ++s) {
+        for (int l = 0; l < lanes; ++l) {
+            if (s > 0 && endOfEpisode(o, l, s))
+                resetEnvLane(env, l);
+            actions[l] = action(env, l, s);
+        }
+        stepEnv(env, actions.data());
+    }
+
+    seedRandom(1);
+    for (long s = 0; s < o.steps; ++s) {
+        for (int l = 0; l < lanes; ++l) {
+            if (s > 0 && endOfEpisode(o, l, s))
+                reference[l] = image;
+            uint16_t keys = env.config.actionKeys[action(env, l, s)];
+            for (int k = 0; k < NUM_KEYS; ++k)
+                reference[l].keys[k] = (keys >> k) & 1;
+        }
+        for (int f = 0; f < o.config.frameSkip; ++f) {
+            for (uint32_t i = 0; i < o.config.cyclesPerFrame; ++i)
+                for (Chip8 &c : reference)
+                    emulateCycle(c);
+            for (Chip8 &c : reference)
+                tickTimers(c);
+        }
+    }
+
+    int bad = 0;
+    for (int l = 0; l < lanes; ++l) {
+        static Chip8 lane;
+        getLane(env.batch, l, lane);
+        bool same = sameObservation(env, l, reference[l]) && lane.pc == reference[l].pc &&
+                    lane.I == reference[l].I && std::memcmp(lane.V, reference[l].V, sizeof(lane.V)) == 0;
+        if (!same) {
+            if (bad++ == 0)
+                std::cerr << "  lane " << l << " differs\n";
+        }
+    }
+    return bad;
+}
+
+
+int main(int argc, char **argv) {
+    Options o;
+    std::string rom = "PONG.ch8";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--lanes" && hasValue)
+            o.config.lanes = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--steps" && hasValue)
+            o.steps = std::atol(argv[++i]);
+        else if (arg == "--skip" && hasValue)
+            o.config.frameSkip = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--cycles" && hasValue)
+            o.config.cyclesPerFrame = static_cast<uint32_t>(std::max(1l, std::atol(argv[++i])));
+        else if (arg == "--episode" && hasValue)
+            o.episode = std::atol(argv[++i]);
+        else if (arg == "--keys" && hasValue) {
+            o.config.actionKeys = { 0 };
+            for (char *p = argv[++i]; *p; p += *p == ',')
+                o.config.actionKeys.push_back(static_cast<uint16_t>(1u << (std::strtol(p, &p, 16) & 0xF)));
+        } else if (arg == "--planes")
+            o.config.obs = ObsFormat::Planes;
+        else if (arg == "--no-verify")
+            o.verify = false;
+        else
+            rom = arg;
+    }
+
+    static Chip8 image;
+    initialise(image);
+    if (!loadROM(rom, image))
+        return 1;
+
+    std::cout << rom << ": " << o.config.lanes << " lanes, " << o.steps << " steps x "
+              << o.config.frameSkip << " frames x " << o.config.cyclesPerFrame << " cycles, "
+              << (o.config.obs == ObsFormat::Planes ? "uint8 planes" : "packed bits") << "\n";
+    int bad = 0;
+    if (o.verify) {
+        bad = verify(image, o);
+        std::cout << "  verify: " << (bad ? std::to_string(bad) + " lanes differ" : "all lanes match") << "\n";
+    }
+
+    static VecEnv env;
+    createEnv(env, image, o.config);
+    std::vector<int> actions(o.config.lanes);
+    double seconds = 0;
+    for (long s = 0; s < o.steps; ++s) {
+        for (int l = 0; l < o.config.lanes; ++l)
+            actions[l] = action(env, l, s);
+        auto start = std::chrono::steady_clock::now();
+        stepEnv(env, actions.data());
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    double laneSteps = static_cast<double>(o.steps) * o.config.lanes;
+    std::cout << "  " << laneSteps / seconds / 1e6 << " M env steps/s, "
+              << laneSteps * o.config.frameSkip / seconds / 1e6 << " M frames/s, "
+              << observationSize(env) * o.config.lanes / 1024.0 << " KiB of observations\n";
+    return bad ? 2 : 0;
+}
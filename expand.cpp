@@ -0,0 +1,182 @@
+#include "expand.hpp"
+
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CHIP8_EXPAND_X86 1
+#endif
+
+
+// Framebuffer expansion for the display path. The SIMD kernels turn a run
+// of framebuffer bits into a lane mask by broadcasting them, ANDing with
+// one bit per lane and comparing, then blend on/off as off ^ (mask &
+// (on ^ off)). The AVX2 kernels are compiled with a target attribute so
+// the rest of the program needs no -mavx2.
+
+constexpr int ROW_PIXELS = 64;
+
+
+static void expandRGBAScalar(const uint64_t *rows, int count, uint32_t *out,
+                             uint32_t on, uint32_t off) {
+    for (int r = 0; r < count; ++r)
+        for (int x = 0; x < ROW_PIXELS; ++x)
+            *out++ = (rows[r] >> (ROW_PIXELS - 1 - x)) & 1 ? on : off;
+}
+
+static void expandGrayScalar(const uint64_t *rows, int count, uint8_t *out,
+                             uint8_t on, uint8_t off) {
+    for (int r = 0; r < count; ++r)
+        for (int x = 0; x < ROW_PIXELS; ++x)
+            *out++ = (rows[r] >> (ROW_PIXELS - 1 - x)) & 1 ? on : off;
+}
+
+
+#if defined(CHIP8_EXPAND_X86)
+
+// 4 pixels per store, one nibble of the row at a time
+static void expandRGBASSE2(const uint64_t *rows, int count, uint32_t *out,
+                           uint32_t on, uint32_t off) {
+    const __m128i lanes = _mm_set_epi32(1, 2, 4, 8);
+    const __m128i vOff = _mm_set1_epi32(static_cast<int>(off));
+    const __m128i vDiff = _mm_set1_epi32(static_cast<int>(on ^ off));
+
+    for (int r = 0; r < count; ++r) {
+        uint64_t row = rows[r];
+        for (int x = 0; x < ROW_PIXELS; x += 4) {
+            int nibble = static_cast<int>((row >> (ROW_PIXELS - 4 - x)) & 0xF);
+            __m128i bits = _mm_and_si128(_mm_set1_epi32(nibble), lanes);
+            __m128i mask = _mm_cmpeq_epi32(bits, lanes);
+            __m128i px = _mm_xor_si128(vOff, _mm_and_si128(mask, vDiff));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), px);
+        }
+        out += ROW_PIXELS;
+    }
+}
+
+// 16 pixels per store: each 8-byte half holds one byte of the row
+static void expandGraySSE2(const uint64_t *rows, int count, uint8_t *out,
+                           uint8_t on, uint8_t off) {
+    const __m128i lanes = _mm_set1_epi64x(static_cast<long long>(0x0102040810204080ull));
+    const __m128i vOff = _mm_set1_epi8(static_cast<char>(off));
+    const __m128i vDiff = _mm_set1_epi8(static_cast<char>(on ^ off));
+    constexpr uint64_t SPLAT = 0x0101010101010101ull;
+
+    for (int r = 0; r < count; ++r) {
+        uint64_t row = rows[r];
+        for (int x = 0; x < ROW_PIXELS; x += 16) {
+            uint64_t hi = (row >> (ROW_PIXELS - 8 - x)) & 0xFF;
+            uint64_t lo = (row >> (ROW_PIXELS - 16 - x)) & 0xFF;
+            __m128i v = _mm_set_epi64x(static_cast<long long>(lo * SPLAT),
+                                       static_cast<long long>(hi * SPLAT));
+            __m128i mask = _mm_cmpeq_epi8(_mm_and_si128(v, lanes), lanes);
+            __m128i px = _mm_xor_si128(vOff, _mm_and_si128(mask, vDiff));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), px);
+        }
+        out += ROW_PIXELS;
+    }
+}
+
+// 8 pixels per store, one byte of the row at a time
+__attribute__((target("avx2")))
+static void expandRGBAAVX2(const uint64_t *rows, int count, uint32_t *out,
+                           uint32_t on, uint32_t off) {
+    const __m256i lanes = _mm256_set_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i vOff = _mm256_set1_epi32(static_cast<int>(off));
+    const __m256i vDiff = _mm256_set1_epi32(static_cast<int>(on ^ off));
+
+    for (int r = 0; r < count; ++r) {
+        uint64_t row = rows[r];
+        for (int x = 0; x < ROW_PIXELS; x += 8) {
+            int byte = static_cast<int>((row >> (ROW_PIXELS - 8 - x)) & 0xFF);
+            __m256i bits = _mm256_and_si256(_mm256_set1_epi32(byte), lanes);
+            __m256i mask = _mm256_cmpeq_epi32(bits, lanes);
+            __m256i px = _mm256_xor_si256(vOff, _mm256_and_si256(mask, vDiff));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + x), px);
+        }
+        out += ROW_PIXELS;
+    }
+}
+
+// 32 pixels per store: the row's next four bytes are broadcast and
+// shuffled so each 8-byte quarter holds one of them
+__attribute__((target("avx2")))
+static void expandGrayAVX2(const uint64_t *rows, int count, uint8_t *out,
+                           uint8_t on, uint8_t off) {
+    const __m256i lanes = _mm256_set1_epi64x(static_cast<long long>(0x0102040810204080ull));
+    const __m256i spread = _mm256_setr_epi8(
+        3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+        1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i vOff = _mm256_set1_epi8(static_cast<char>(off));
+    const __m256i vDiff = _mm256_set1_epi8(static_cast<char>(on ^ off));
+
+    for (int r = 0; r < count; ++r) {
+        uint64_t row = rows[r];
+        for (int x = 0; x < ROW_PIXELS; x += 32) {
+            // Most significant byte first on screen, so it is byte 3 here
+            uint32_t word = static_cast<uint32_t>(row >> (ROW_PIXELS - 32 - x));
+            __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(word)), spread);
+            __m256i mask = _mm256_cmpeq_epi8(_mm256_and_si256(v, lanes), lanes);
+            __m256i px = _mm256_xor_si256(vOff, _mm256_and_si256(mask, vDiff));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + x), px);
+        }
+        out += ROW_PIXELS;
+    }
+}
+
+#endif
+
+
+ExpandIsa expandIsa() {
+#if defined(CHIP8_EXPAND_X86)
+    static const ExpandIsa best = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return ExpandIsa::AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return ExpandIsa::SSE2;
+        return ExpandIsa::Scalar;
+    }();
+    return best;
+#else
+    return ExpandIsa::Scalar;
+#endif
+}
+
+
+const char *expandIsaName(ExpandIsa isa) {
+    switch (isa) {
+        case ExpandIsa::Scalar: return "scalar";
+        case ExpandIsa::SSE2:   return "sse2";
+        case ExpandIsa::AVX2:   return "avx2";
+        default:                return "?";
+    }
+}
+
+
+void expandRGBA(const uint64_t *rows, int count, uint32_t *out,
+                uint32_t on, uint32_t off, ExpandIsa isa) {
+    if (isa > expandIsa())
+        isa = expandIsa();
+    switch (isa) {
+#if defined(CHIP8_EXPAND_X86)
+        case ExpandIsa::AVX2: expandRGBAAVX2(rows, count, out, on, off); break;
+        case ExpandIsa::SSE2: expandRGBASSE2(rows, count, out, on, off); break;
+#endif
+        default:              expandRGBAScalar(rows, count, out, on, off); break;
+    }
+}
+
+
+void expandGray(const uint64_t *rows, int count, uint8_t *out,
+                uint8_t on, uint8_t off, ExpandIsa isa) {
+    if (isa > expandIsa())
+        isa = expandIsa();
+    switch (isa) {
+#if defined(CHIP8_EXPAND_X86)
+        case ExpandIsa::AVX2: expandGrayAVX2(rows, count, out, on, off); break;
+        case ExpandIsa::SSE2: expandGraySSE2(rows, count, out, on, off); break;
+#endif
+        default:              expandGrayScalar(rows, count, out, on, off); break;
+    }
+}
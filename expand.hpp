@@ -0,0 +1,28 @@
+#ifndef EXPAND_HPP
+#define EXPAND_HPP
+
+#include <cstdint>
+
+// Instruction sets the framebuffer expansion kernels are built for.
+enum class ExpandIsa : uint8_t {
+    Scalar,
+    SSE2,
+    AVX2,
+    COUNT
+};
+
+// Best kernel this CPU supports, detected once through CPUID.
+ExpandIsa expandIsa();
+const char *expandIsaName(ExpandIsa isa);
+
+// Expand count packed framebuffer rows (Chip8::gfx layout, x = 0 in the
+// most significant bit) to 64 output pixels each, on for set bits and off
+// for clear ones. Every kernel writes byte-identical output; asking for an
+// ISA the CPU lacks falls back to the best one it has.
+void expandRGBA(const uint64_t *rows, int count, uint32_t *out,
+                uint32_t on, uint32_t off, ExpandIsa isa = expandIsa());
+void expandGray(const uint64_t *rows, int count, uint8_t *out,
+                uint8_t on, uint8_t off, ExpandIsa isa = expandIsa());
+
+
+#endif
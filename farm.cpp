@@ -0,0 +1,216 @@
+#include "cpu.hpp"
+#include "pool.hpp"
+#include "script.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Runs many headless jobs in one process on a work-stealing thread pool,
+// one Chip8 per job, instead of one chip8_headless process per run.
+//
+//   ./chip8_farm [--threads N] [--repeat N] [--hash-only] (jobs.txt | rom.ch8) ...
+//
+// A job list has one job per line: a ROM path followed by any of the
+// chip8_headless options (script.hpp), e.g.
+//
+//   PONG.ch8 --frames 600 --tap 100:1:30
+//   "Particle Demo [zeroZshadow, 2008].ch8" --instructions 100000 --seed 7
+//
+// Blank lines and lines starting with # are skipped. A .ch8 argument is a
+// job with the default options. --repeat runs every job N times, which
+// makes a quick throughput test. Each ROM is loaded once up front and
+// every job writes its hashes, final registers and timing into its own
+// preallocated result slot, printed in job order when all are done.
+
+struct FarmJob {
+    std::string rom;
+    size_t image;                    // index into Farm::images
+    RunSpec spec;
+};
+
+// One per job, each on its own cache line so workers never share one
+struct alignas(64) FarmResult {
+    uint64_t screen = 0;
+    uint64_t state = 0;
+    long instructions = 0;
+    double seconds = 0;
+    int worker = -1;
+    uint16_t pc = 0;
+    uint16_t I = 0;
+    uint8_t sp = 0;
+    uint8_t V[NUM_REGISTERS] = {};
+};
+
+struct Farm {
+    std::vector<Chip8> images;       // initialised and loaded
+    std::vector<FarmJob> jobs;
+    std::vector<FarmResult> results;
+};
+
+
+// Splits on whitespace; double quotes keep a path with spaces together.
+static std::vector<std::string> tokenize(const std::string &line) {
+    std::vector<std::string> tokens;
+    std::string token;
+    bool quoted = false, any = false;
+    for (char ch : line) {
+        if (ch == '"') {
+            quoted = !quoted;
+            any = true;
+        } else if (!quoted && (ch == ' ' || ch == '\t' || ch == '\r')) {
+            if (any)
+                tokens.push_back(token);
+            token.clear();
+            any = false;
+        } else {
+            token += ch;
+            any = true;
+        }
+    }
+    if (any)
+        tokens.push_back(token);
+    return tokens;
+}
+
+
+static bool addJob(Farm &farm, std::map<std::string, size_t> &loaded, const std::vector<std::string> &tokens) {
+    FarmJob job;
+    job.rom = tokens[0];
+    for (size_t i = 1; i < tokens.size(); ++i) {
+        if (!parseRunOption(tokens, i, job.spec)) {
+            std::cerr << "Bad option for " << job.rom << ": " << tokens[i] << "\n";
+            return false;
+        }
+    }
+    finishRunSpec(job.spec);
+
+    auto it = loaded.find(job.rom);
+    if (it == loaded.end()) {
+        Chip8 &image = farm.images.emplace_back();
+        initialise(image);
+        if (!loadROM(job.rom, image))
+            return false;
+        it = loaded.emplace(job.rom, farm.images.size() - 1).first;
+    }
+    job.image = it->second;
+    farm.jobs.push_back(std::move(job));
+    return true;
+}
+
+
+static bool readJobList(Farm &farm, std::map<std::string, size_t> &loaded, const std::string &path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Failed to open job list: " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::vector<std::string> tokens = tokenize(line);
+        if (tokens.empty() || tokens[0][0] == '#')
+            continue;
+        if (!addJob(farm, loaded, tokens))
+            return false;
+    }
+    return true;
+}
+
+
+static void runJob(size_t index, int worker, void *ctx) {
+    Farm &farm = *static_cast<Farm *>(ctx);
+    const FarmJob &job = farm.jobs[index];
+    FarmResult &r = farm.results[index];
+
+    auto start = std::chrono::steady_clock::now();
+    Chip8 c = farm.images[job.image];
+    r.instructions = runScripted(c, job.spec);
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    r.screen = screenHash(c);
+    r.state = stateHash(c);
+    r.worker = worker;
+    r.pc = c.pc;
+    r.I = c.I;
+    r.sp = c.sp;
+    for (int i = 0; i < NUM_REGISTERS; ++i)
+        r.V[i] = c.V[i];
+}
+
+
+int main(int argc, char **argv) {
+    int threads = 0;
+    long repeat = 1;
+    bool hashOnly = false;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--threads" && hasValue)
+            threads = std::atoi(argv[++i]);
+        else if (arg == "--repeat" && hasValue)
+            repeat = std::max(1l, std::atol(argv[++i]));
+        else if (arg == "--hash-only")
+            hashOnly = true;
+        else
+            inputs.push_back(arg);
+    }
+    if (inputs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--threads N] [--repeat N] [--hash-only] (jobs.txt | rom.ch8) ...\n";
+        return 1;
+    }
+
+    Farm farm;
+    std::map<std::string, size_t> loaded;
+    for (const std::string &input : inputs) {
+        bool ok = input.ends_with(".ch8") ? addJob(farm, loaded, { input })
+                                          : readJobList(farm, loaded, input);
+        if (!ok)
+            return 1;
+    }
+    size_t unique = farm.jobs.size();
+    for (long r = 1; r < repeat; ++r)
+        for (size_t j = 0; j < unique; ++j)
+            farm.jobs.push_back(farm.jobs[j]);
+    if (farm.jobs.size() > MAX_POOL_JOBS) {
+        std::cerr << "Too many jobs: " << farm.jobs.size() << " (at most " << MAX_POOL_JOBS << ")\n";
+        return 1;
+    }
+    farm.results.resize(farm.jobs.size());
+
+    ThreadPool pool;
+    startPool(pool, threads);
+    auto start = std::chrono::steady_clock::now();
+    PoolStats stats = runJobs(pool, farm.jobs.size(), runJob, &farm);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stopPool(pool);
+
+    double busy = 0;
+    double instructions = 0;
+    for (size_t j = 0; j < farm.jobs.size(); ++j) {
+        const FarmResult &r = farm.results[j];
+        busy += r.seconds;
+        instructions += static_cast<double>(r.instructions);
+        if (hashOnly)
+            std::printf("%016llx %016llx %s\n", static_cast<unsigned long long>(r.screen),
+                        static_cast<unsigned long long>(r.state), farm.jobs[j].rom.c_str());
+        else
+            std::printf("%5zu  screen %016llx  state %016llx  PC %03X  I %03X  SP %X  %8.3f ms  w%-3d %s\n",
+                        j, static_cast<unsigned long long>(r.screen), static_cast<unsigned long long>(r.state),
+                        r.pc, r.I, r.sp, r.seconds * 1e3, r.worker, farm.jobs[j].rom.c_str());
+    }
+
+    if (!hashOnly)
+        std::printf("%zu jobs on %d threads in %.3f s: %.0f jobs/s, %.1f MIPS, %.2f s in jobs (%.2fx busy), %llu steals\n",
+                    farm.jobs.size(), pool.workers, wall, farm.jobs.size() / wall,
+                    instructions / wall / 1e6, busy, busy / wall, static_cast<unsigned long long>(stats.steals));
+    return 0;
+}
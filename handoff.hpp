@@ -0,0 +1,94 @@
+#ifndef HANDOFF_HPP
+#define HANDOFF_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free structures for passing data between exactly one producer
+// thread and one consumer thread. Neither side ever waits for the other.
+
+
+// Three slots: the writer owns one, the reader owns one and the third is
+// the most recently published value. Publishing and taking swap a slot
+// with the middle one, so the writer never blocks on a slow reader and the
+// reader always gets the newest complete value; intermediate ones are
+// dropped.
+template <typename T>
+struct TripleBuffer {
+    static constexpr uint8_t FRESH = 4;     // middle slot not yet taken
+
+    T slots[3] = {};
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t back = 0;           // writer side
+    alignas(64) uint8_t front = 2;          // reader side
+};
+
+
+// Writer: the slot to fill before the next publish.
+template <typename T>
+T &writeSlot(TripleBuffer<T> &b) {
+    return b.slots[b.back];
+}
+
+
+template <typename T>
+void publish(TripleBuffer<T> &b) {
+    b.back = b.middle.exchange(b.back | TripleBuffer<T>::FRESH, std::memory_order_acq_rel) & 3;
+}
+
+
+// Reader: swaps in the newest published value if there is one. Returns
+// false (and leaves readSlot unchanged) if nothing was published since the
+// last call.
+template <typename T>
+bool take(TripleBuffer<T> &b) {
+    if (!(b.middle.load(std::memory_order_relaxed) & TripleBuffer<T>::FRESH))
+        return false;
+    b.front = b.middle.exchange(b.front, std::memory_order_acq_rel) & 3;
+    return true;
+}
+
+
+template <typename T>
+const T &readSlot(const TripleBuffer<T> &b) {
+    return b.slots[b.front];
+}
+
+
+// Bounded single-producer single-consumer ring. N must be a power of two.
+template <typename T, size_t N>
+struct SpscQueue {
+    static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+    T items[N];
+    alignas(64) std::atomic<size_t> head{0};   // next to pop, consumer side
+    alignas(64) std::atomic<size_t> tail{0};   // next to push, producer side
+};
+
+
+// Returns false if the queue is full.
+template <typename T, size_t N>
+bool push(SpscQueue<T, N> &q, const T &item) {
+    size_t tail = q.tail.load(std::memory_order_relaxed);
+    if (tail - q.head.load(std::memory_order_acquire) == N)
+        return false;
+    q.items[tail % N] = item;
+    q.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+
+// Returns false if the queue is empty.
+template <typename T, size_t N>
+bool pop(SpscQueue<T, N> &q, T &item) {
+    size_t head = q.head.load(std::memory_order_relaxed);
+    if (head == q.tail.load(std::memory_order_acquire))
+        return false;
+    item = q.items[head % N];
+    q.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+
+#endif
@@ -0,0 +1,129 @@
+#include "cpu.hpp"
+#include "script.hpp"
+#include "shmring.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Runs a ROM with no display, at full speed, and prints the final screen,
+// registers and hashes. Needs only cpu.cpp, script.cpp and shmring.cpp,
+// so it builds anywhere; CI and farm jobs compare the hashes against
+// known-good runs.
+//
+//   ./chip8_headless rom.ch8 [--frames N | --instructions N] [--cycles N]
+//                    [--seed N] [--press F:K] [--release F:K] [--tap F:K[:N]]
+//                    [--hash-only] [--export NAME [--export-slots N] [--export-replace]
+//                    [--realtime]]
+//
+// The run options are described in script.hpp. --export publishes every
+// frame to the shared-memory ring NAME (shmring.hpp) for other processes
+// to read; it fails if NAME is already in use unless --export-replace is
+// given. --realtime paces the run at 60 frames per second so a viewer
+// can follow it.
+
+struct Export {
+    RingWriter ring;
+    bool realtime = false;
+    std::chrono::steady_clock::time_point next;
+};
+
+
+static void exportTo(const Chip8 &c, long executed, void *ctx) {
+    Export &e = *static_cast<Export *>(ctx);
+    exportFrame(e.ring, c, static_cast<uint64_t>(executed));
+    if (e.realtime) {
+        e.next += std::chrono::microseconds(16667);
+        std::this_thread::sleep_until(e.next);
+    }
+}
+
+
+static void printScreen(const Chip8 &c) {
+    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+        std::string line(SCREEN_WIDTH, '.');
+        for (int x = 0; x < SCREEN_WIDTH; ++x)
+            if (pixelAt(c, x, y))
+                line[x] = '#';
+        std::cout << line << "\n";
+    }
+}
+
+
+static void printRegisters(const Chip8 &c) {
+    std::printf("PC %03X  I %03X  SP %X  OP %04X  DT %02X  ST %02X\n",
+                c.pc, c.I, c.sp, c.opcode, c.delayTimer, c.soundTimer);
+    for (int i = 0; i < NUM_REGISTERS; ++i)
+        std::printf("V%X %02X%s", i, c.V[i], i % 8 == 7 ? "\n" : "  ");
+    std::printf("Stack");
+    for (int i = 0; i < c.sp && i < STACK_SIZE; ++i)
+        std::printf(" %03X", c.stack[i]);
+    std::printf("\n");
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " rom.ch8 [--frames N | --instructions N] [--cycles N]\n"
+                  << "       [--seed N] [--press F:K] [--release F:K] [--tap F:K[:N]] [--hash-only]\n"
+                  << "       [--export NAME [--export-slots N] [--export-replace] [--realtime]]\n";
+        return 1;
+    }
+
+    RunSpec spec;
+    bool hashOnly = false;
+    std::string exportName;
+    uint32_t exportSlots = 256;
+    bool exportReplace = false;
+    static Export exporter;
+    std::vector<std::string> args(argv, argv + argc);
+    for (size_t i = 2; i < args.size(); ++i) {
+        bool hasValue = i + 1 < args.size();
+        if (args[i] == "--hash-only")
+            hashOnly = true;
+        else if (args[i] == "--export" && hasValue)
+            exportName = args[++i];
+        else if (args[i] == "--export-slots" && hasValue)
+            exportSlots = static_cast<uint32_t>(std::max(1l, std::atol(args[++i].c_str())));
+        else if (args[i] == "--export-replace")
+            exportReplace = true;
+        else if (args[i] == "--realtime")
+            exporter.realtime = true;
+        else if (!parseRunOption(args, i, spec)) {
+            std::cerr << "Bad option: " << args[i] << "\n";
+            return 1;
+        }
+    }
+    finishRunSpec(spec);
+
+    static Chip8 chip8;
+    initialise(chip8);
+    if (!loadROM(argv[1], chip8))
+        return 1;
+
+    if (!exportName.empty() && !openRingWriter(exporter.ring, exportName, exportSlots, exportReplace))
+        return 1;
+
+    auto start = std::chrono::steady_clock::now();
+    exporter.next = start;
+    long executed = runScripted(chip8, spec, exportName.empty() ? nullptr : exportTo, &exporter);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    closeRingWriter(exporter.ring);
+
+    if (!hashOnly) {
+        printScreen(chip8);
+        printRegisters(chip8);
+        std::printf("%ld frames, %ld instructions in %.3f s\n", spec.frames, executed, seconds);
+    }
+    std::printf("screen %016llx\nstate  %016llx\n",
+                static_cast<unsigned long long>(screenHash(chip8)),
+                static_cast<unsigned long long>(stateHash(chip8)));
+    return 0;
+}
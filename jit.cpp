@@ -0,0 +1,680 @@
+#include "jit.hpp"
+#include "decode.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define CHIP8_JIT_X64 1
+#endif
+
+
+constexpr uint16_t NO_JIT_BLOCK = 0xFFFF;
+
+
+void resetJitCache(JitCache &cache) {
+    for (uint16_t &id : cache.blockAt)
+        id = NO_JIT_BLOCK;
+    cache.numBlocks = 0;
+    cache.codeUsed = 0;
+    for (uint64_t &w : cache.code_slots)
+        w = 0;
+}
+
+
+// Drops every live block that covers a slot written since the last sync.
+void syncJitCache(Chip8 &c, JitCache &cache) {
+    uint64_t dirty[NUM_WRITE_WORDS];
+    if (!takeWrites(c, cache.code_slots, dirty))
+        return;
+
+    for (uint16_t id = 0; id < cache.numBlocks; ++id) {
+        const JitBlock &b = cache.blocks[id];
+        if (cache.blockAt[b.start >> 1] != id)
+            continue;
+        unsigned slots = b.len ? b.len : 1;
+        for (unsigned s = b.start / 2; s < b.start / 2u + slots; ++s) {
+            if (slotWritten(dirty, s)) {
+                cache.blockAt[b.start >> 1] = NO_JIT_BLOCK;
+                break;
+            }
+        }
+    }
+}
+
+
+// One interpreted instruction, for everything the JIT leaves out.
+static void interpretOne(Chip8 &c, JitCache &cache) {
+    Instr d = decode(readOpcode(c, c.pc));
+    c.opcode = d.opcode;
+    executeInstr(c, d);
+    if (anyWritten(c))
+        syncJitCache(c, cache);
+}
+
+
+#if defined(CHIP8_JIT_X64)
+
+// Worst-case machine code for one block: prologue/epilogue for every
+// allocatable register plus MAX_JIT_BLOCK_LEN of the longest sequences,
+// each with its budget check and exit stub.
+constexpr size_t MAX_BLOCK_CODE = 8192;
+
+enum HostReg : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// V registers live in these for the duration of a block, in allocation
+// order; I lives in RSI and the Chip8 pointer stays in RDI. EDX holds the
+// budget the block was entered with. RAX and RCX are scratch.
+constexpr HostReg V_HOST_REGS[] = { R8, R9, R10, R11, RBX, RBP, R12, R13, R14, R15 };
+constexpr int NUM_V_HOST_REGS = sizeof(V_HOST_REGS) / sizeof(V_HOST_REGS[0]);
+constexpr HostReg I_HOST_REG = RSI;
+
+// Group-1 ALU opcodes (r/m32, r32) and their /digit for the immediate form
+enum AluOp : uint8_t { ALU_ADD = 0x01, ALU_OR = 0x09, ALU_AND = 0x21,
+                       ALU_SUB = 0x29, ALU_XOR = 0x31, ALU_CMP = 0x39 };
+enum AluExt : uint8_t { EXT_ADD = 0, EXT_AND = 4, EXT_CMP = 7 };
+enum ShiftExt : uint8_t { EXT_SHL = 4, EXT_SHR = 5 };
+enum Cond : uint8_t { CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5 };
+
+constexpr int32_t OFF_V = offsetof(Chip8, V);
+constexpr int32_t OFF_I = offsetof(Chip8, I);
+constexpr int32_t OFF_PC = offsetof(Chip8, pc);
+constexpr int32_t OFF_STACK = offsetof(Chip8, stack);
+constexpr int32_t OFF_SP = offsetof(Chip8, sp);
+constexpr int32_t OFF_DT = offsetof(Chip8, delayTimer);
+constexpr int32_t OFF_ST = offsetof(Chip8, soundTimer);
+constexpr int32_t OFF_OPCODE = offsetof(Chip8, opcode);
+constexpr int32_t OFF_KEYS = offsetof(Chip8, keys);
+
+namespace {
+
+struct Emitter {
+    uint8_t *p;
+};
+
+}
+
+static void emit8(Emitter &e, uint8_t b) { *e.p++ = b; }
+
+static void emit16(Emitter &e, uint16_t v) {
+    emit8(e, v & 0xFF);
+    emit8(e, v >> 8);
+}
+
+static void emit32(Emitter &e, uint32_t v) {
+    for (int i = 0; i < 4; ++i)
+        emit8(e, (v >> (8 * i)) & 0xFF);
+}
+
+static void rex(Emitter &e, int reg, int rm) {
+    uint8_t r = 0x40 | ((reg >> 3) << 2) | (rm >> 3);
+    if (r != 0x40)
+        emit8(e, r);
+}
+
+static void modrmReg(Emitter &e, int reg, int rm) {
+    emit8(e, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// [rdi + disp32]
+static void modrmChip8(Emitter &e, int reg, int32_t disp) {
+    emit8(e, 0x80 | ((reg & 7) << 3) | RDI);
+    emit32(e, static_cast<uint32_t>(disp));
+}
+
+// [rdi + rax*2 + disp32]
+static void modrmStack(Emitter &e, int reg, int32_t disp) {
+    emit8(e, 0x84 | ((reg & 7) << 3));
+    emit8(e, 0x47);
+    emit32(e, static_cast<uint32_t>(disp));
+}
+
+static void movRR(Emitter &e, int dst, int src) {
+    rex(e, src, dst);
+    emit8(e, 0x89);
+    modrmReg(e, src, dst);
+}
+
+static void movRI(Emitter &e, int dst, uint32_t imm) {
+    rex(e, 0, dst);
+    emit8(e, 0xB8 + (dst & 7));
+    emit32(e, imm);
+}
+
+static void aluRR(Emitter &e, AluOp op, int dst, int src) {
+    rex(e, src, dst);
+    emit8(e, op);
+    modrmReg(e, src, dst);
+}
+
+static void aluRI(Emitter &e, AluExt ext, int dst, uint32_t imm) {
+    rex(e, 0, dst);
+    emit8(e, 0x81);
+    modrmReg(e, ext, dst);
+    emit32(e, imm);
+}
+
+static void shiftRI(Emitter &e, ShiftExt ext, int dst, uint8_t n) {
+    rex(e, 0, dst);
+    emit8(e, 0xC1);
+    modrmReg(e, ext, dst);
+    emit8(e, n);
+}
+
+static void imulRRI(Emitter &e, int dst, int src, uint8_t imm) {
+    rex(e, dst, src);
+    emit8(e, 0x6B);
+    modrmReg(e, dst, src);
+    emit8(e, imm);
+}
+
+static void cmov(Emitter &e, Cond cc, int dst, int src) {
+    rex(e, dst, src);
+    emit8(e, 0x0F);
+    emit8(e, 0x40 | cc);
+    modrmReg(e, dst, src);
+}
+
+// setcc cl
+static void setccCL(Emitter &e, Cond cc) {
+    emit8(e, 0x0F);
+    emit8(e, 0x90 | cc);
+    modrmReg(e, 0, RCX);
+}
+
+// movzx dst, byte [rdi + disp]
+static void loadByte(Emitter &e, int dst, int32_t disp) {
+    rex(e, dst, RDI);
+    emit8(e, 0x0F);
+    emit8(e, 0xB6);
+    modrmChip8(e, dst, disp);
+}
+
+// movzx dst, word [rdi + disp]
+static void loadWord(Emitter &e, int dst, int32_t disp) {
+    rex(e, dst, RDI);
+    emit8(e, 0x0F);
+    emit8(e, 0xB7);
+    modrmChip8(e, dst, disp);
+}
+
+// cmp byte [rdi + rax + disp32], 0
+static void testKeyAt(Emitter &e, int32_t disp) {
+    emit8(e, 0x80);
+    emit8(e, 0x84 | (EXT_CMP << 3));
+    emit8(e, 0x07);
+    emit32(e, static_cast<uint32_t>(disp));
+    emit8(e, 0);
+}
+
+// mov byte [rdi + disp], al
+static void storeByteAL(Emitter &e, int32_t disp) {
+    emit8(e, 0x88);
+    modrmChip8(e, RAX, disp);
+}
+
+// mov word [rdi + disp], ax
+static void storeWordAX(Emitter &e, int32_t disp) {
+    emit8(e, 0x66);
+    emit8(e, 0x89);
+    modrmChip8(e, RAX, disp);
+}
+
+// mov word [rdi + disp], imm16
+static void storeWordImm(Emitter &e, int32_t disp, uint16_t imm) {
+    emit8(e, 0x66);
+    emit8(e, 0xC7);
+    modrmChip8(e, 0, disp);
+    emit16(e, imm);
+}
+
+// inc/dec byte [rdi + disp]
+static void addByteOne(Emitter &e, int32_t disp, bool increment) {
+    emit8(e, 0xFE);
+    modrmChip8(e, increment ? 0 : 1, disp);
+}
+
+// cmp edx, imm8
+static void cmpBudget(Emitter &e, uint8_t n) {
+    emit8(e, 0x83);
+    modrmReg(e, EXT_CMP, RDX);
+    emit8(e, n);
+}
+
+// je/jmp rel32 to a target patched in later; returns the rel32 to patch
+static uint8_t *jumpIfEqual(Emitter &e) {
+    emit8(e, 0x0F);
+    emit8(e, 0x84);
+    uint8_t *rel = e.p;
+    emit32(e, 0);
+    return rel;
+}
+
+static uint8_t *jump(Emitter &e) {
+    emit8(e, 0xE9);
+    uint8_t *rel = e.p;
+    emit32(e, 0);
+    return rel;
+}
+
+static void patchJump(uint8_t *rel, const uint8_t *target) {
+    int32_t d = static_cast<int32_t>(target - (rel + 4));
+    for (int i = 0; i < 4; ++i)
+        rel[i] = static_cast<uint8_t>(static_cast<uint32_t>(d) >> (8 * i));
+}
+
+static void push(Emitter &e, int r) {
+    rex(e, 0, r);
+    emit8(e, 0x50 + (r & 7));
+}
+
+static void pop(Emitter &e, int r) {
+    rex(e, 0, r);
+    emit8(e, 0x58 + (r & 7));
+}
+
+static bool calleeSaved(int r) {
+    return r == RBX || r == RBP || r >= R12;
+}
+
+
+static bool isNative(Op op) {
+    switch (op) {
+        case Op::CLS:
+        case Op::RND:
+        case Op::DRW:
+        case Op::LD_VX_K:
+        case Op::LD_B_VX:
+        case Op::LD_I_VX:
+        case Op::LD_VX_I:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// V registers an instruction reads or writes
+static uint16_t regsTouched(const Instr &d) {
+    const uint16_t x = 1u << d.x, y = 1u << d.y, f = 1u << 0xF;
+    switch (d.op) {
+        case Op::SE_VX_NN: case Op::SNE_VX_NN: case Op::SKP: case Op::SKNP:
+        case Op::LD_VX_NN: case Op::ADD_VX_NN:
+        case Op::LD_VX_DT: case Op::LD_DT_VX: case Op::LD_ST_VX:
+        case Op::ADD_I_VX: case Op::LD_F_VX:
+            return x;
+        case Op::SE_VX_VY: case Op::SNE_VX_VY:
+        case Op::LD_VX_VY: case Op::OR: case Op::AND: case Op::XOR:
+            return x | y;
+        case Op::ADD_VX_VY: case Op::SUB: case Op::SUBN:
+            return x | y | f;
+        case Op::SHR: case Op::SHL:
+            return x | f;
+        case Op::JP_V0:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// V registers an instruction writes
+static uint16_t regsWritten(const Instr &d) {
+    const uint16_t x = 1u << d.x, f = 1u << 0xF;
+    switch (d.op) {
+        case Op::LD_VX_NN: case Op::ADD_VX_NN: case Op::LD_VX_DT:
+        case Op::LD_VX_VY: case Op::OR: case Op::AND: case Op::XOR:
+            return x;
+        case Op::ADD_VX_VY: case Op::SUB: case Op::SUBN:
+        case Op::SHR: case Op::SHL:
+            return x | f;
+        default:
+            return 0;
+    }
+}
+
+static bool writesI(Op op) {
+    return op == Op::LD_I || op == Op::ADD_I_VX || op == Op::LD_F_VX;
+}
+
+static bool readsI(Op op) {
+    return op == Op::ADD_I_VX;
+}
+
+
+// Sets pc to a + 4 if cond holds after the preceding compare, else a + 2.
+static void emitSkip(Emitter &e, Cond cc, uint16_t a) {
+    movRI(e, RAX, a + 2);
+    movRI(e, RCX, a + 4);
+    cmov(e, cc, RAX, RCX);
+    storeWordAX(e, OFF_PC);
+}
+
+static void emitInstr(Emitter &e, const Instr &d, uint16_t a, const int8_t *host) {
+    const int vx = host[d.x], vy = host[d.y], vf = host[0xF];
+
+    switch (d.op) {
+        case Op::NOP:
+            break;
+        case Op::RET:
+            addByteOne(e, OFF_SP, false);
+            loadByte(e, RAX, OFF_SP);
+            emit8(e, 0x0F);
+            emit8(e, 0xB7);
+            modrmStack(e, RAX, OFF_STACK);          // movzx eax, stack[sp]
+            storeWordAX(e, OFF_PC);
+            break;
+        case Op::JP:
+            storeWordImm(e, OFF_PC, d.nnn);
+            break;
+        case Op::CALL:
+            loadByte(e, RAX, OFF_SP);
+            emit8(e, 0x66);
+            emit8(e, 0xC7);
+            modrmStack(e, 0, OFF_STACK);            // stack[sp] = a + 2
+            emit16(e, a + 2);
+            addByteOne(e, OFF_SP, true);
+            storeWordImm(e, OFF_PC, d.nnn);
+            break;
+        case Op::SE_VX_NN:
+            aluRI(e, EXT_CMP, vx, d.nn());
+            emitSkip(e, CC_E, a);
+            break;
+        case Op::SNE_VX_NN:
+            aluRI(e, EXT_CMP, vx, d.nn());
+            emitSkip(e, CC_NE, a);
+            break;
+        case Op::SE_VX_VY:
+            aluRR(e, ALU_CMP, vx, vy);
+            emitSkip(e, CC_E, a);
+            break;
+        case Op::SNE_VX_VY:
+            aluRR(e, ALU_CMP, vx, vy);
+            emitSkip(e, CC_NE, a);
+            break;
+        case Op::SKP:
+        case Op::SKNP:
+            // keys[V[x]], indexed the same way as in emulateCycle
+            movRR(e, RAX, vx);
+            testKeyAt(e, OFF_KEYS);
+            emitSkip(e, d.op == Op::SKP ? CC_NE : CC_E, a);
+            break;
+        case Op::JP_V0:
+            movRR(e, RAX, host[0]);
+            aluRI(e, EXT_ADD, RAX, d.nnn);
+            storeWordAX(e, OFF_PC);
+            break;
+        case Op::LD_VX_NN:
+            movRI(e, vx, d.nn());
+            break;
+        case Op::ADD_VX_NN:
+            aluRI(e, EXT_ADD, vx, d.nn());
+            aluRI(e, EXT_AND, vx, 0xFF);
+            break;
+        case Op::LD_VX_VY:
+            movRR(e, vx, vy);
+            break;
+        case Op::OR:
+            aluRR(e, ALU_OR, vx, vy);
+            break;
+        case Op::AND:
+            aluRR(e, ALU_AND, vx, vy);
+            break;
+        case Op::XOR:
+            aluRR(e, ALU_XOR, vx, vy);
+            break;
+        case Op::ADD_VX_VY:
+            // The sum is taken before VF is written, as in emulateCycle
+            movRR(e, RAX, vx);
+            aluRR(e, ALU_ADD, RAX, vy);
+            movRR(e, RCX, RAX);
+            shiftRI(e, EXT_SHR, RCX, 8);
+            movRR(e, vf, RCX);
+            aluRI(e, EXT_AND, RAX, 0xFF);
+            movRR(e, vx, RAX);
+            break;
+        case Op::SUB:
+        case Op::SUBN: {
+            // VF is written first, then Vx/Vy are read again
+            const int lhs = d.op == Op::SUB ? vx : vy;
+            const int rhs = d.op == Op::SUB ? vy : vx;
+            aluRR(e, ALU_XOR, RCX, RCX);
+            aluRR(e, ALU_CMP, lhs, rhs);
+            setccCL(e, CC_AE);
+            movRR(e, vf, RCX);
+            movRR(e, RAX, lhs);
+            aluRR(e, ALU_SUB, RAX, rhs);
+            aluRI(e, EXT_AND, RAX, 0xFF);
+            movRR(e, vx, RAX);
+            break;
+        }
+        case Op::SHR:
+            movRR(e, RAX, vx);
+            aluRI(e, EXT_AND, RAX, 0x01);
+            movRR(e, vf, RAX);
+            movRR(e, RAX, vx);
+            shiftRI(e, EXT_SHR, RAX, 1);
+            movRR(e, vx, RAX);
+            break;
+        case Op::SHL:
+            movRR(e, RAX, vx);
+            shiftRI(e, EXT_SHR, RAX, 7);
+            movRR(e, vf, RAX);
+            movRR(e, RAX, vx);
+            shiftRI(e, EXT_SHL, RAX, 1);
+            aluRI(e, EXT_AND, RAX, 0xFF);
+            movRR(e, vx, RAX);
+            break;
+        case Op::LD_I:
+            movRI(e, I_HOST_REG, d.nnn);
+            break;
+        case Op::ADD_I_VX:
+            aluRR(e, ALU_ADD, I_HOST_REG, vx);
+            aluRI(e, EXT_AND, I_HOST_REG, 0xFFFF);
+            break;
+        case Op::LD_F_VX:
+            imulRRI(e, I_HOST_REG, vx, 5);
+            break;
+        case Op::LD_VX_DT:
+            loadByte(e, vx, OFF_DT);
+            break;
+        case Op::LD_DT_VX:
+            movRR(e, RAX, vx);
+            storeByteAL(e, OFF_DT);
+            break;
+        case Op::LD_ST_VX:
+            movRR(e, RAX, vx);
+            storeByteAL(e, OFF_ST);
+            break;
+        default:
+            break;
+    }
+}
+
+
+static bool mapCode(JitCache &cache) {
+    void *p = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return false;
+    cache.code = static_cast<uint8_t *>(p);
+    cache.codeUsed = 0;
+    return mprotect(cache.code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) == 0;
+}
+
+
+static uint16_t compileBlock(const Chip8 &c, JitCache &cache) {
+    if (cache.numBlocks == MAX_JIT_BLOCKS ||
+        cache.codeUsed + MAX_BLOCK_CODE > JIT_CODE_SIZE)
+        resetJitCache(cache);
+
+    // Scan: native instructions up to a branch, a non-native instruction,
+    // the length cap, or a block needing more V registers than we can map.
+    Instr instrs[MAX_JIT_BLOCK_LEN];
+    int n = 0;
+    uint16_t touched = 0, written = 0;
+    bool usesI = false, dirtiesI = false;
+    unsigned addr = c.pc;
+    while (n < MAX_JIT_BLOCK_LEN && addr + 1 < MEMORY_SIZE) {
+        Instr d = decode(readOpcode(c, addr));
+        uint16_t t = touched | regsTouched(d);
+        if (!isNative(d.op) || std::popcount(t) > NUM_V_HOST_REGS)
+            break;
+        touched = t;
+        written |= regsWritten(d);
+        usesI |= readsI(d.op) || writesI(d.op);
+        dirtiesI |= writesI(d.op);
+        instrs[n++] = d;
+        addr += 2;
+        if (isBranch(d.op))
+            break;
+    }
+
+    uint16_t id = cache.numBlocks++;
+    JitBlock &b = cache.blocks[id];
+    b.start = c.pc;
+    b.len = static_cast<uint16_t>(n);
+    b.offset = static_cast<uint32_t>(cache.codeUsed);
+    cache.blockAt[c.pc >> 1] = id;
+    for (unsigned s = b.start / 2; s < (n ? addr : b.start + 2u) / 2; ++s)
+        cache.code_slots[s / 64] |= uint64_t{1} << (s % 64);
+    if (n == 0)
+        return id;
+
+    int8_t host[NUM_REGISTERS];
+    int numHost = 0;
+    for (int v = 0; v < NUM_REGISTERS; ++v)
+        host[v] = (touched >> v) & 1 ? V_HOST_REGS[numHost++] : -1;
+
+    if (mprotect(cache.code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        b.len = 0;
+        return id;
+    }
+    Emitter e{ cache.code + cache.codeUsed };
+
+    // void block(Chip8 *c, uint32_t budget): the budget arrives in ESI,
+    // which I is about to take over
+    movRR(e, RDX, RSI);
+    for (int i = 0; i < numHost; ++i)
+        if (calleeSaved(V_HOST_REGS[i]))
+            push(e, V_HOST_REGS[i]);
+    for (int v = 0; v < NUM_REGISTERS; ++v)
+        if (host[v] >= 0)
+            loadByte(e, host[v], OFF_V + v);
+    if (usesI)
+        loadWord(e, I_HOST_REG, OFF_I);
+
+    // Only the last instruction can branch, so a block entered with less
+    // budget than its length leaves after that many instructions
+    uint8_t *exits[MAX_JIT_BLOCK_LEN] = {};
+    for (int i = 0; i < n; ++i) {
+        if (i > 0) {
+            cmpBudget(e, static_cast<uint8_t>(i));
+            exits[i] = jumpIfEqual(e);
+        }
+        emitInstr(e, instrs[i], static_cast<uint16_t>(b.start + 2 * i), host);
+    }
+
+    if (!isBranch(instrs[n - 1].op))
+        storeWordImm(e, OFF_PC, static_cast<uint16_t>(addr));
+    storeWordImm(e, OFF_OPCODE, instrs[n - 1].opcode);
+    uint8_t *writeBack = e.p;
+    for (int v = 0; v < NUM_REGISTERS; ++v) {
+        if ((written >> v) & 1) {
+            movRR(e, RAX, host[v]);
+            storeByteAL(e, OFF_V + v);
+        }
+    }
+    if (dirtiesI) {
+        movRR(e, RAX, I_HOST_REG);
+        storeWordAX(e, OFF_I);
+    }
+    for (int i = numHost - 1; i >= 0; --i)
+        if (calleeSaved(V_HOST_REGS[i]))
+            pop(e, V_HOST_REGS[i]);
+    emit8(e, 0xC3);                                 // ret
+
+    // Early exits, out of line: stop at instruction i, then write back
+    for (int i = 1; i < n; ++i) {
+        patchJump(exits[i], e.p);
+        storeWordImm(e, OFF_PC, static_cast<uint16_t>(b.start + 2 * i));
+        storeWordImm(e, OFF_OPCODE, instrs[i - 1].opcode);
+        patchJump(jump(e), writeBack);
+    }
+
+    cache.codeUsed = static_cast<size_t>(e.p - cache.code);
+    if (mprotect(cache.code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0)
+        b.len = 0;
+    return id;
+}
+
+
+void releaseJitCache(JitCache &cache) {
+    if (cache.code)
+        munmap(cache.code, JIT_CODE_SIZE);
+    cache.code = nullptr;
+    resetJitCache(cache);
+}
+
+
+uint32_t runJit(Chip8 &c, JitCache &cache, uint32_t budget) {
+    uint32_t done = 0;
+
+    if (!cache.code && !mapCode(cache)) {
+        releaseJitCache(cache);
+        while (done < budget) {
+            interpretOne(c, cache);
+            ++done;
+            if (c.key_wait)
+                break;
+        }
+        return done;
+    }
+
+    // Stores made since the last run (loader, other engines)
+    syncJitCache(c, cache);
+
+    while (done < budget) {
+        if (!(c.pc & UNCACHED_PC_MASK)) {
+            uint16_t id = cache.blockAt[c.pc >> 1];
+            if (id == NO_JIT_BLOCK)
+                id = compileBlock(c, cache);
+
+            const JitBlock &b = cache.blocks[id];
+            if (b.len != 0) {
+                using BlockFn = void (*)(Chip8 *, uint32_t);
+                reinterpret_cast<BlockFn>(cache.code + b.offset)(&c, budget - done);
+                done += std::min<uint32_t>(b.len, budget - done);
+                continue;
+            }
+        }
+        interpretOne(c, cache);
+        ++done;
+        if (c.key_wait)
+            break;
+    }
+    return done;
+}
+
+#else
+
+void releaseJitCache(JitCache &cache) {
+    resetJitCache(cache);
+}
+
+uint32_t runJit(Chip8 &c, JitCache &cache, uint32_t budget) {
+    uint32_t done = 0;
+    while (done < budget) {
+        interpretOne(c, cache);
+        ++done;
+        if (c.key_wait)
+            break;
+    }
+    return done;
+}
+
+#endif
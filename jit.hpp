@@ -0,0 +1,48 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include "cpu.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr int MAX_JIT_BLOCK_LEN = 64;
+constexpr int MAX_JIT_BLOCKS = 2048;
+constexpr size_t JIT_CODE_SIZE = 1 << 20;
+
+// A compiled run of instructions starting at start. len counts the
+// instructions it executes (and the cycles charged); a block with len 0
+// marks an address whose first instruction is left to the interpreter.
+struct JitBlock {
+    uint16_t start;
+    uint16_t len;
+    uint32_t offset;    // entry point within JitCache::code
+};
+
+// x86-64 translation cache for one Chip8. Straight-line ALU, load, timer
+// and branch instructions, key skips included, are compiled to native
+// code that keeps the V registers and I in host registers for the whole
+// block. DXYN, CLS, CXNN, FX0A, FX33, FX55 and FX65 end a block and run
+// on the interpreter, as do blocks overwritten by the program itself. A
+// block entered with less budget than its length stops early.
+//
+// The executable buffer is mapped on first use and kept until
+// releaseJitCache. On other hosts runJit just interprets.
+struct JitCache {
+    uint16_t blockAt[MEMORY_SIZE / 2];           // even address -> block id
+    JitBlock blocks[MAX_JIT_BLOCKS];
+    uint16_t numBlocks;
+    uint64_t code_slots[NUM_WRITE_WORDS];        // slots covered by any block
+    uint8_t *code = nullptr;
+    size_t codeUsed = 0;
+};
+
+void resetJitCache(JitCache &cache);
+void releaseJitCache(JitCache &cache);
+void syncJitCache(Chip8 &c, JitCache &cache);
+
+// Runs up to budget instructions, returns the number executed.
+uint32_t runJit(Chip8 &c, JitCache &cache, uint32_t budget);
+
+
+#endif
@@ -0,0 +1,148 @@
+#include "pool.hpp"
+
+#include <algorithm>
+
+
+static uint64_t packRange(uint32_t begin, uint32_t end) {
+    return begin | (uint64_t{end} << 32);
+}
+
+static uint32_t rangeBegin(uint64_t bounds) {
+    return static_cast<uint32_t>(bounds);
+}
+
+static uint32_t rangeEnd(uint64_t bounds) {
+    return static_cast<uint32_t>(bounds >> 32);
+}
+
+
+// Owner: takes the first job of its range.
+static bool takeFront(WorkRange &r, uint32_t &index) {
+    uint64_t bounds = r.bounds.load(std::memory_order_relaxed);
+    for (;;) {
+        uint32_t begin = rangeBegin(bounds), end = rangeEnd(bounds);
+        if (begin >= end)
+            return false;
+        if (r.bounds.compare_exchange_weak(bounds, packRange(begin + 1, end),
+                                           std::memory_order_acquire, std::memory_order_relaxed)) {
+            index = begin;
+            return true;
+        }
+    }
+}
+
+
+// Thief: takes the back half of a victim's range, at least one job.
+static bool stealBack(WorkRange &victim, uint32_t &begin, uint32_t &end) {
+    uint64_t bounds = victim.bounds.load(std::memory_order_relaxed);
+    for (;;) {
+        uint32_t b = rangeBegin(bounds), e = rangeEnd(bounds);
+        if (b >= e)
+            return false;
+        uint32_t mid = b + (e - b) / 2;
+        if (victim.bounds.compare_exchange_weak(bounds, packRange(b, mid),
+                                                std::memory_order_acquire, std::memory_order_relaxed)) {
+            begin = mid;
+            end = e;
+            return true;
+        }
+    }
+}
+
+
+// Runs jobs until every job of the batch has finished, stealing when the
+// worker's own range is empty. A stolen range becomes the thief's own, so
+// it can be stolen from in turn.
+static void drain(ThreadPool &pool, int self) {
+    WorkRange &own = pool.ranges[self];
+    while (pool.remaining.load(std::memory_order_acquire) > 0) {
+        uint32_t index;
+        if (takeFront(own, index)) {
+            pool.job(index, self, pool.jobCtx);
+            pool.remaining.fetch_sub(1, std::memory_order_acq_rel);
+            continue;
+        }
+
+        bool stole = false;
+        for (int k = 1; k < pool.workers && !stole; ++k) {
+            uint32_t begin, end;
+            if (stealBack(pool.ranges[(self + k) % pool.workers], begin, end)) {
+                own.bounds.store(packRange(begin, end), std::memory_order_release);
+                pool.steals.fetch_add(1, std::memory_order_relaxed);
+                stole = true;
+            }
+        }
+        // Nothing left to steal: the last jobs are running elsewhere
+        if (!stole)
+            std::this_thread::yield();
+    }
+}
+
+
+static void worker(ThreadPool &pool, int self) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.start.wait(lock, [&] { return pool.quit || pool.generation != seen; });
+            if (pool.quit)
+                return;
+            seen = pool.generation;
+        }
+
+        drain(pool, self);
+
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (--pool.running == 0)
+            pool.finished.notify_all();
+    }
+}
+
+
+void startPool(ThreadPool &pool, int workers) {
+    if (workers <= 0)
+        workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    pool.workers = workers;
+    pool.ranges = std::make_unique<WorkRange[]>(workers);
+    pool.quit = false;
+    for (int i = 0; i < workers; ++i)
+        pool.threads.emplace_back(worker, std::ref(pool), i);
+}
+
+
+void stopPool(ThreadPool &pool) {
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.quit = true;
+    }
+    pool.start.notify_all();
+    for (std::thread &t : pool.threads)
+        t.join();
+    pool.threads.clear();
+}
+
+
+PoolStats runJobs(ThreadPool &pool, size_t jobs, void (*job)(size_t index, int worker, void *ctx), void *ctx) {
+    PoolStats stats;
+    if (jobs == 0 || jobs > MAX_POOL_JOBS)
+        return stats;
+
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.job = job;
+    pool.jobCtx = ctx;
+    pool.steals.store(0, std::memory_order_relaxed);
+    pool.remaining.store(jobs, std::memory_order_relaxed);
+    for (int i = 0; i < pool.workers; ++i) {
+        uint32_t begin = static_cast<uint32_t>(jobs * i / pool.workers);
+        uint32_t end = static_cast<uint32_t>(jobs * (i + 1) / pool.workers);
+        pool.ranges[i].bounds.store(packRange(begin, end), std::memory_order_relaxed);
+    }
+    pool.running = pool.workers;
+    ++pool.generation;
+    pool.start.notify_all();
+    pool.finished.wait(lock, [&] { return pool.running == 0; });
+
+    stats.jobs = jobs;
+    stats.steals = pool.steals.load(std::memory_order_relaxed);
+    return stats;
+}
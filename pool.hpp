@@ -0,0 +1,64 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool over job indices. runJobs splits 0 .. jobs - 1
+// into one contiguous range per worker. A worker takes jobs from the front
+// of its own range; once that is empty it steals the back half of another
+// worker's, so a few slow jobs never leave the other cores idle. A range
+// is two 32-bit bounds in one atomic word, so taking and stealing are
+// single compare-and-swaps and the job list itself never changes.
+
+// Ranges hold 32-bit job indices, so a batch has at most this many jobs.
+constexpr size_t MAX_POOL_JOBS = UINT32_MAX;
+
+// Each worker's range on its own cache line: [begin, end) as
+// begin | end << 32.
+struct alignas(64) WorkRange {
+    std::atomic<uint64_t> bounds{0};
+};
+
+struct PoolStats {
+    uint64_t jobs = 0;           // jobs run; 0 if the batch was rejected
+    uint64_t steals = 0;         // successful steals
+};
+
+struct ThreadPool {
+    int workers = 0;
+    std::unique_ptr<WorkRange[]> ranges;
+    std::vector<std::thread> threads;
+
+    // The batch being run; written under mutex before generation changes
+    void (*job)(size_t index, int worker, void *ctx) = nullptr;
+    void *jobCtx = nullptr;
+    std::atomic<size_t> remaining{0};
+    std::atomic<uint64_t> steals{0};
+
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable finished;
+    uint64_t generation = 0;
+    int running = 0;
+    bool quit = false;
+};
+
+// Starts workers threads; 0 means one per hardware thread.
+void startPool(ThreadPool &pool, int workers = 0);
+void stopPool(ThreadPool &pool);
+
+// Calls job(index, worker, ctx) once for every index below jobs, spread
+// over the workers, and returns when all have finished. Jobs must not
+// call runJobs on the same pool. A batch of more than MAX_POOL_JOBS jobs
+// is rejected without running any.
+PoolStats runJobs(ThreadPool &pool, size_t jobs, void (*job)(size_t index, int worker, void *ctx), void *ctx);
+
+
+#endif
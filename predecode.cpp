@@ -0,0 +1,253 @@
+#include "predecode.hpp"
+
+#include <bit>
+#include <cstdint>
+
+
+
+const char *fusedName(Fused f) {
+    switch (f) {
+#define CHIP8_FUSED_NAME(name) case Fused::name: return #name;
+        CHIP8_FUSED_OPS(CHIP8_FUSED_NAME)
+#undef CHIP8_FUSED_NAME
+        default: return "?";
+    }
+}
+
+
+void resetDecodeCache(DecodeCache &cache) {
+    for (Instr &e : cache.entries)
+        e.op = OP_UNDECODED;
+    for (uint64_t &h : cache.fusedHits)
+        h = 0;
+}
+
+
+// Peephole pass: folds the instructions after d (at pc) into a
+// superinstruction when they form one of the CHIP8_FUSED_OPS idioms.
+static Instr fuse(const Chip8 &c, Instr d, unsigned pc) {
+    if (pc + 2 * MAX_FUSED_LEN > MEMORY_SIZE)
+        return d;
+    Instr next = decode(readOpcode(c, pc + 2));
+
+    switch (d.op) {
+        case Op::LD_VX_DT: {
+            Instr jump = decode(readOpcode(c, pc + 4));
+            if (next.op == Op::SE_VX_NN && next.x == d.x && next.nn() == 0 &&
+                jump.op == Op::JP) {
+                d.op = fusedOp(Fused::POLL_DT);
+                d.nnn = jump.nnn;
+            }
+            break;
+        }
+        case Op::SE_VX_NN:
+        case Op::SNE_VX_NN:
+            if (next.op == Op::JP) {
+                d.op = fusedOp(d.op == Op::SE_VX_NN ? Fused::SE_JP : Fused::SNE_JP);
+                d.y = d.nn();
+                d.nnn = next.nnn;
+            }
+            break;
+        case Op::LD_VX_NN:
+            if (next.op == Op::LD_VX_NN) {
+                d.op = fusedOp(Fused::LD_PAIR);
+                d.y = next.x;
+                d.n = next.nn();
+            }
+            break;
+        case Op::LD_I:
+            if (next.op == Op::DRW) {
+                next.op = fusedOp(Fused::LD_I_DRW);
+                next.nnn = d.nnn;
+                d = next;
+            }
+            break;
+        default:
+            break;
+    }
+    return d;
+}
+
+
+static Instr fill(const Chip8 &c, DecodeCache &cache, unsigned pc) {
+    Instr d = decode(readOpcode(c, pc));
+    if (cache.fusion)
+        d = fuse(c, d, pc);
+    cache.entries[pc >> 1] = d;
+    return d;
+}
+
+
+// Executes a superinstruction at c.pc and returns how many of its
+// instructions ran; state matches stepping them one by one. left is the
+// remaining budget, at least fusedLen(F).
+template<Fused F>
+static inline uint32_t executeFused(Chip8 &c, const Instr &d, uint32_t left) {
+    if constexpr (F == Fused::SE_JP || F == Fused::SNE_JP) {
+        if ((c.V[d.x] == d.y) == (F == Fused::SE_JP)) {
+            c.pc += 4;
+            return 1;
+        }
+        c.pc = d.nnn;
+        c.opcode = static_cast<uint16_t>(0x1000 | d.nnn);
+        return 2;
+    } else if constexpr (F == Fused::LD_PAIR) {
+        c.V[d.x] = d.nn();
+        c.V[d.y] = d.n;
+        c.pc += 4;
+        c.opcode = static_cast<uint16_t>(0x6000 | d.y << 8 | d.n);
+        return 2;
+    } else if constexpr (F == Fused::LD_I_DRW) {
+        c.I = d.nnn;
+        c.pc += 2;
+        execute<Op::DRW>(c, d);
+        return 2;
+    } else if constexpr (F == Fused::POLL_DT) {
+        if (d.nnn == c.pc && c.delayTimer != 0)
+            return skipIdleLoop(c, left);
+        c.V[d.x] = c.delayTimer;
+        if (c.V[d.x] == 0) {
+            c.pc += 6;
+            c.opcode = static_cast<uint16_t>(0x3000 | d.x << 8);
+            return 2;
+        }
+        c.pc = d.nnn;
+        c.opcode = static_cast<uint16_t>(0x1000 | d.nnn);
+        return 3;
+    }
+}
+
+
+// Drops every entry whose slot was written since the last sync, along
+// with superinstructions starting up to MAX_FUSED_LEN - 1 slots earlier.
+void syncDecodeCache(Chip8 &c, DecodeCache &cache) {
+    uint32_t words = c.mem_dirty_words;
+    c.mem_dirty_words = 0;
+    while (words) {
+        int w = std::countr_zero(words);
+        words &= words - 1;
+        uint64_t bits = c.mem_dirty[w];
+        c.mem_dirty[w] = 0;
+        while (bits) {
+            int slot = w * 64 + std::countr_zero(bits);
+            for (int i = 0; i < MAX_FUSED_LEN && i <= slot; ++i)
+                cache.entries[slot - i].op = OP_UNDECODED;
+            bits &= bits - 1;
+        }
+    }
+}
+
+
+uint32_t runCached(Chip8 &c, DecodeCache &cache, uint32_t budget) {
+    uint32_t done = 0;
+    Instr d;
+
+    // Stores made since the last run (loader, other engines)
+    syncDecodeCache(c, cache);
+
+#if defined(__GNUC__)
+    static void *const handlers[NUM_OPS + 1 + NUM_FUSED] = {
+#define CHIP8_OP_LABEL(name) __extension__ &&op_##name,
+        CHIP8_OPS(CHIP8_OP_LABEL)
+#undef CHIP8_OP_LABEL
+        __extension__ &&op_undecoded,
+#define CHIP8_FUSED_LABEL(name) __extension__ &&fused_##name,
+        CHIP8_FUSED_OPS(CHIP8_FUSED_LABEL)
+#undef CHIP8_FUSED_LABEL
+    };
+
+#define DISPATCH()                                                          \
+    do {                                                                    \
+        if (done == budget)                                                 \
+            return done;                                                    \
+        ++done;                                                             \
+        if (c.pc & UNCACHED_PC_MASK)                                        \
+            d = decode(readOpcode(c, c.pc));                                \
+        else                                                                \
+            d = cache.entries[c.pc >> 1];                                   \
+        c.opcode = d.opcode;                                                \
+        __extension__ ({ goto *handlers[static_cast<uint8_t>(d.op)]; });    \
+    } while (0)
+
+    DISPATCH();
+
+op_undecoded:
+    d = fill(c, cache, c.pc);
+    c.opcode = d.opcode;
+    __extension__ ({ goto *handlers[static_cast<uint8_t>(d.op)]; });
+
+// Too little budget left for the whole superinstruction: run only its
+// first instruction.
+op_unfused:
+    d = decode(readOpcode(c, c.pc));
+    c.opcode = d.opcode;
+    __extension__ ({ goto *handlers[static_cast<uint8_t>(d.op)]; });
+
+#define CHIP8_FUSED_HANDLER(name)                                       \
+    fused_##name:                                                       \
+        if (budget - done + 1 < fusedLen(Fused::name))                  \
+            goto op_unfused;                                            \
+        ++cache.fusedHits[static_cast<int>(Fused::name)];               \
+        done += executeFused<Fused::name>(c, d, budget - done + 1) - 1; \
+        DISPATCH();
+    CHIP8_FUSED_OPS(CHIP8_FUSED_HANDLER)
+#undef CHIP8_FUSED_HANDLER
+
+#define CHIP8_OP_HANDLER(name)                      \
+    op_##name:                                      \
+        execute<Op::name>(c, d);                    \
+        if constexpr (writesMemory(Op::name))       \
+            syncDecodeCache(c, cache);              \
+        if constexpr (waitsForKey(Op::name))        \
+            if (c.key_wait)                         \
+                return done;                        \
+        DISPATCH();
+    CHIP8_OPS(CHIP8_OP_HANDLER)
+#undef CHIP8_OP_HANDLER
+#undef DISPATCH
+
+#else
+    while (done < budget) {
+        ++done;
+        if (c.pc & UNCACHED_PC_MASK) {
+            d = decode(readOpcode(c, c.pc));
+        } else {
+            d = cache.entries[c.pc >> 1];
+            if (d.op == OP_UNDECODED)
+                d = fill(c, cache, c.pc);
+            if (isFused(d.op) && budget - done + 1 < fusedLen(fusedOf(d.op)))
+                d = decode(readOpcode(c, c.pc));
+        }
+        c.opcode = d.opcode;
+        if (isFused(d.op)) {
+            Fused f = fusedOf(d.op);
+            ++cache.fusedHits[static_cast<int>(f)];
+            switch (f) {
+#define CHIP8_FUSED_CASE(name)                                                  \
+                case Fused::name:                                               \
+                    done += executeFused<Fused::name>(c, d, budget - done + 1) - 1; \
+                    break;
+                CHIP8_FUSED_OPS(CHIP8_FUSED_CASE)
+#undef CHIP8_FUSED_CASE
+                default: break;
+            }
+            continue;
+        }
+        switch (d.op) {
+#define CHIP8_OP_CASE(name)                             \
+            case Op::name:                              \
+                execute<Op::name>(c, d);                \
+                if constexpr (writesMemory(Op::name))   \
+                    syncDecodeCache(c, cache);          \
+                if constexpr (waitsForKey(Op::name))    \
+                    if (c.key_wait)                     \
+                        return done;                    \
+                break;
+            CHIP8_OPS(CHIP8_OP_CASE)
+#undef CHIP8_OP_CASE
+            default: break;
+        }
+    }
+    return done;
+#endif
+}
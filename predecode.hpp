@@ -0,0 +1,76 @@
+#ifndef PREDECODE_HPP
+#define PREDECODE_HPP
+
+#include "cpu.hpp"
+#include "decode.hpp"
+
+#include <cstdint>
+
+constexpr int NUM_DECODE_ENTRIES = MEMORY_SIZE / 2;
+constexpr Op OP_UNDECODED = Op::COUNT;
+
+// Superinstructions formed by the peephole pass when an entry is filled.
+// Each covers two or three consecutive instructions and repacks their
+// operands into the entry for the first:
+//   SE_JP    3XNN 1NNN        x, y = NN, nnn = jump target
+//   SNE_JP   4XNN 1NNN        x, y = NN, nnn = jump target
+//   LD_PAIR  6XNN 6YMM        x, nnn = NN, y = Y, n = MM
+//   LD_I_DRW ANNN DXYN        nnn = I, x/y/n/opcode from DXYN
+//   POLL_DT  FX07 3X00 1NNN   x, nnn = jump target
+#define CHIP8_FUSED_OPS(X) \
+    X(SE_JP)               \
+    X(SNE_JP)              \
+    X(LD_PAIR)             \
+    X(LD_I_DRW)            \
+    X(POLL_DT)
+
+enum class Fused : uint8_t {
+#define CHIP8_FUSED_ENUM(name) name,
+    CHIP8_FUSED_OPS(CHIP8_FUSED_ENUM)
+#undef CHIP8_FUSED_ENUM
+    COUNT
+};
+
+constexpr int NUM_FUSED = static_cast<int>(Fused::COUNT);
+constexpr int MAX_FUSED_LEN = 3;
+
+// Longest path through a superinstruction, in instructions.
+constexpr uint32_t fusedLen(Fused f) {
+    return f == Fused::POLL_DT ? 3 : 2;
+}
+
+// Fused ops are stored in Instr::op after OP_UNDECODED.
+constexpr Op fusedOp(Fused f) {
+    return static_cast<Op>(NUM_OPS + 1 + static_cast<int>(f));
+}
+
+constexpr bool isFused(Op op) {
+    return op > OP_UNDECODED;
+}
+
+constexpr Fused fusedOf(Op op) {
+    return static_cast<Fused>(static_cast<int>(op) - NUM_OPS - 1);
+}
+
+const char *fusedName(Fused f);
+
+// One predecoded instruction per even address in Chip8::memory. Entries are
+// filled lazily on first execution and dropped only when a store touches
+// their slot, as reported through Chip8::mem_dirty.
+//
+// A cache follows a single Chip8: it clears mem_dirty as it consumes it, so
+// call resetDecodeCache when pointing it at another machine.
+struct DecodeCache {
+    Instr entries[NUM_DECODE_ENTRIES];
+    bool fusion = true;                 // run the peephole pass on fill
+    uint64_t fusedHits[NUM_FUSED];      // dispatches per superinstruction
+};
+
+void resetDecodeCache(DecodeCache &cache);
+void syncDecodeCache(Chip8 &c, DecodeCache &cache);
+
+// Runs up to budget instructions, returns the number executed.
+uint32_t runCached(Chip8 &c, DecodeCache &cache, uint32_t budget);
+
+
+#endif
@@ -0,0 +1,143 @@
+#include "cpu.hpp"
+#include "shmring.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+// Throughput benchmark and torture test for the shared-memory frame ring:
+// this process publishes frames as fast as it can while forked reader
+// processes, attached by name like any other reader, consume them.
+//
+//   ./ring_bench [--frames N] [--slots N] [--readers N] [--rate N]
+//
+// --rate publishes N frames per second instead of as fast as possible, to
+// check that readers keep up at a given rate without dropping frames.
+//
+// Every row of frame n's screen holds n, so a reader can tell a torn
+// frame from a good one. A frame endRead accepts must never be torn;
+// frames the writer overwrote first are only counted as dropped.
+
+struct Options {
+    uint64_t frames = 2'000'000;
+    uint32_t slots = 256;
+    int readers = 1;
+    double rate = 0;
+};
+
+
+static int readFrames(const std::string &name, int id, int ready) {
+    RingReader ring;
+    if (!openRingReader(ring, name))
+        return 1;
+    char byte = 1;
+    if (write(ready, &byte, 1) != 1)
+        return 1;
+    close(ready);
+
+    uint64_t read = 0, torn = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (;;) {
+        const ExportedFrame *f = beginRead(ring);
+        if (!f) {
+            if (writerClosed(ring) && ring.next >= framesPublished(ring))
+                break;
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t frame = f->frame;
+        bool whole = f->instructions == frame;
+        for (int y = 0; y < SCREEN_HEIGHT; ++y)
+            whole &= f->gfx[y] == frame;
+        if (!endRead(ring))
+            continue;
+        ++read;
+        torn += !whole;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("  reader %d: %llu frames read (%.2f M/s, %.0f MB/s), %llu dropped, %llu torn\n", id,
+                static_cast<unsigned long long>(read), read / seconds / 1e6,
+                read * sizeof(ExportedFrame) / seconds / 1e6, static_cast<unsigned long long>(ring.dropped),
+                static_cast<unsigned long long>(torn));
+    closeRingReader(ring);
+    return torn ? 2 : 0;
+}
+
+
+int main(int argc, char **argv) {
+    Options o;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue)
+            o.frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--slots" && hasValue)
+            o.slots = static_cast<uint32_t>(std::max(1l, std::atol(argv[++i])));
+        else if (arg == "--readers" && hasValue)
+            o.readers = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--rate" && hasValue)
+            o.rate = std::atof(argv[++i]);
+    }
+
+    std::string name = "chip8_ring_bench_" + std::to_string(getpid());
+    RingWriter ring;
+    if (!openRingWriter(ring, name, o.slots))
+        return 1;
+
+    int ready[2];
+    if (pipe(ready) != 0)
+        return 1;
+    std::fflush(stdout);
+    for (int r = 0; r < o.readers; ++r) {
+        if (fork() == 0) {
+            close(ready[0]);
+            std::exit(readFrames(name, r, ready[1]));
+        }
+    }
+    close(ready[1]);
+    for (int r = 0; r < o.readers; ++r) {
+        char byte;
+        if (read(ready[0], &byte, 1) != 1) {
+            std::cerr << "A reader failed to attach\n";
+            break;
+        }
+    }
+    close(ready[0]);
+
+    std::printf("%llu frames of %zu bytes, %u slots, %d readers\n", static_cast<unsigned long long>(o.frames),
+                sizeof(ExportedFrame), ring.header->slots, o.readers);
+
+    static Chip8 c;
+    initialise(c);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t n = 0; n < o.frames; ++n) {
+        if (o.rate > 0)
+            std::this_thread::sleep_until(start + std::chrono::duration<double>(n / o.rate));
+        std::fill(std::begin(c.gfx), std::end(c.gfx), n);
+        exportFrame(ring, c, n);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    closeRingWriter(ring);
+    std::printf("  writer: %.2f M frames/s, %.0f ns per frame\n", o.frames / seconds / 1e6,
+                seconds * 1e9 / static_cast<double>(o.frames));
+    std::fflush(stdout);
+
+    int failures = 0;
+    for (int r = 0; r < o.readers; ++r) {
+        int status = 0;
+        wait(&status);
+        failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    return failures ? 2 : 0;
+}
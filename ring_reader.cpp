@@ -0,0 +1,98 @@
+#include "cpu.hpp"
+#include "shmring.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+
+// Example reader for the shared-memory frame ring: attaches to a running
+// chip8_headless --export NAME or chip8 --export NAME and prints the
+// registers of every frame, and optionally the screen, until the writer
+// exits.
+//
+//   ./ring_reader NAME [--latest] [--screen] [--every N]
+//
+// --latest skips to the newest frame each time instead of reading every
+// one, as a live viewer would. Frames are read in place: the fields needed
+// are taken from the slot, and only used if endRead confirms the writer
+// did not overwrite the slot meanwhile.
+
+static void printScreen(const uint64_t *gfx) {
+    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+        char line[SCREEN_WIDTH + 1];
+        for (int x = 0; x < SCREEN_WIDTH; ++x)
+            line[x] = (gfx[y] >> (SCREEN_WIDTH - 1 - x)) & 1 ? '#' : '.';
+        line[SCREEN_WIDTH] = '\0';
+        std::printf("%s\n", line);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " NAME [--latest] [--screen] [--every N]\n";
+        return 1;
+    }
+    bool latest = false, screen = false;
+    long every = 1;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--latest")
+            latest = true;
+        else if (arg == "--screen")
+            screen = true;
+        else if (arg == "--every" && i + 1 < argc)
+            every = std::max(1l, std::atol(argv[++i]));
+    }
+
+    RingReader ring;
+    if (!openRingReader(ring, argv[1]))
+        return 1;
+
+    uint64_t read = 0;
+    for (;;) {
+        if (latest)
+            skipToLatest(ring);
+        const ExportedFrame *f = beginRead(ring);
+        if (!f) {
+            if (writerClosed(ring) && ring.next >= framesPublished(ring))
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        uint64_t frame = f->frame;
+        uint64_t instructions = f->instructions;
+        uint16_t pc = f->pc, I = f->I, keys = f->keys;
+        uint8_t sp = f->sp, V[NUM_REGISTERS];
+        uint64_t gfx[SCREEN_HEIGHT];
+        std::memcpy(V, f->V, sizeof(V));
+        if (screen)
+            std::memcpy(gfx, f->gfx, sizeof(gfx));
+        if (!endRead(ring))
+            continue;
+
+        if (read++ % every != 0)
+            continue;
+        std::printf("frame %6llu  %10llu instr  PC %03X  I %03X  SP %X  keys %04X  V",
+                    static_cast<unsigned long long>(frame), static_cast<unsigned long long>(instructions),
+                    pc, I, sp, keys);
+        for (uint8_t v : V)
+            std::printf(" %02X", v);
+        std::printf("\n");
+        if (screen)
+            printScreen(gfx);
+    }
+
+    std::printf("%llu frames read, %llu dropped\n", static_cast<unsigned long long>(read),
+                static_cast<unsigned long long>(ring.dropped));
+    closeRingReader(ring);
+    return 0;
+}
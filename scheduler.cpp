@@ -0,0 +1,124 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+
+static double seconds(SchedClock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+
+void resetScheduler(Scheduler &s, uint32_t ips, SchedClock::time_point now) {
+    SchedulerStats stats = s.stats;
+    s = Scheduler{};
+    s.ips = ips ? ips : 1;
+    s.start = now;
+    s.window = now;
+    s.stats = stats;
+    s.stats.maxLagMs = 0.0;
+}
+
+
+// Runs n instructions' worth of emulated time. An engine stops early
+// only when FX0A blocks, and the wait then takes up the rest.
+static uint64_t runSlice(Chip8 &c, Core &core, uint64_t n) {
+    uint64_t done = 0;
+    while (done < n) {
+        uint32_t ran = runCore(c, core, static_cast<uint32_t>(std::min<uint64_t>(n - done, UINT32_MAX)));
+        if (ran == 0)
+            break;
+        done += ran;
+    }
+    return done;
+}
+
+
+// First instruction count at which emulated time reaches tick k
+static uint64_t tickAt(const Scheduler &s, uint64_t k) {
+    return (k * s.ips + TIMER_HZ - 1) / TIMER_HZ;
+}
+
+
+// Runs up to emulated instruction count target, ticking the timers at
+// every boundary on the way
+static uint64_t advance(Scheduler &s, Chip8 &c, Core &core, uint64_t target) {
+    uint64_t executed = 0;
+    while (s.instructions < target) {
+        uint64_t tick = tickAt(s, s.timerTicks + 1);
+        uint64_t end = std::min(target, tick);
+        executed += runSlice(c, core, end - s.instructions);
+        s.instructions = end;
+        if (end == tick) {
+            if (c.delayTimer > 0) --c.delayTimer;
+            if (c.soundTimer > 0) --c.soundTimer;
+            ++s.timerTicks;
+        }
+    }
+    return executed;
+}
+
+
+static void measure(Scheduler &s, SchedClock::time_point now) {
+    double windowS = seconds(now - s.window);
+    if (windowS >= 1.0) {
+        s.stats.timerHz = (s.timerTicks - s.windowTicks) / windowS;
+        s.window = now;
+        s.windowTicks = s.timerTicks;
+    }
+}
+
+
+// Drops whatever is beyond MAX_CATCH_UP_S behind now. Returns the wall
+// seconds since start afterwards.
+static double catchUp(Scheduler &s, SchedClock::time_point now) {
+    double wall = seconds(now - s.start);
+    double behind = wall - static_cast<double>(s.instructions) / s.ips;
+    if (behind > MAX_CATCH_UP_S) {
+        auto lost = std::chrono::duration_cast<SchedClock::duration>(
+            std::chrono::duration<double>(behind - MAX_CATCH_UP_S));
+        s.start += lost;
+        s.stats.lostMs += seconds(lost) * 1000.0;
+        wall = seconds(now - s.start);
+    }
+    return wall;
+}
+
+
+uint64_t runUntil(Scheduler &s, Chip8 &c, Core &core, SchedClock::time_point now) {
+    double wall = catchUp(s, now);
+    s.stats.lagMs = std::max(0.0, seconds(now - nextTimerTick(s)) * 1000.0);
+    s.stats.maxLagMs = std::max(s.stats.maxLagMs, s.stats.lagMs);
+
+    uint64_t executed = advance(s, c, core, static_cast<uint64_t>(wall * s.ips));
+    s.stats.driftMs = (static_cast<double>(s.instructions) / s.ips - wall) * 1000.0;
+    measure(s, now);
+    return executed;
+}
+
+
+uint64_t runTo(Scheduler &s, Chip8 &c, Core &core, SchedClock::time_point t) {
+    double wall = catchUp(s, t);
+    return advance(s, c, core, static_cast<uint64_t>(std::max(0.0, wall) * s.ips));
+}
+
+
+uint64_t runTurbo(Scheduler &s, Chip8 &c, Core &core, uint64_t n) {
+    uint64_t executed = advance(s, c, core, s.instructions + n);
+
+    // Emulated time ran ahead on purpose; line the wall clock back up so
+    // returning to runUntil neither waits for it nor counts it as drift
+    auto now = SchedClock::now();
+    auto emulated = std::chrono::duration<double>(static_cast<double>(s.instructions) / s.ips);
+    s.start = now - std::chrono::duration_cast<SchedClock::duration>(emulated);
+    s.stats.lagMs = 0.0;
+    s.stats.driftMs = 0.0;
+    measure(s, now);
+    return executed;
+}
+
+
+SchedClock::time_point nextTimerTick(const Scheduler &s) {
+    // Rounded up so waking at it always finds the tick due
+    auto at = std::chrono::duration<double>(static_cast<double>(tickAt(s, s.timerTicks + 1)) / s.ips);
+    return s.start + std::chrono::ceil<SchedClock::duration>(at);
+}
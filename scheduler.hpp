@@ -0,0 +1,66 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "cpu.hpp"
+#include "engine.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+using SchedClock = std::chrono::steady_clock;
+
+constexpr int TIMER_HZ = 60;
+constexpr uint32_t DEFAULT_IPS = 500;
+
+// Catching up further than this after a stall (debugger, suspend, a slow
+// host) drops the excess instead of running it in one burst.
+constexpr double MAX_CATCH_UP_S = 0.25;
+
+// Measured against the wall clock; all times in milliseconds.
+struct SchedulerStats {
+    double lagMs = 0.0;         // how late the last wake was for a due timer tick
+    double maxLagMs = 0.0;
+    double driftMs = 0.0;       // emulated minus wall time after the last run
+    double lostMs = 0.0;        // total wall time dropped by MAX_CATCH_UP_S
+    double timerHz = 0.0;       // timer ticks per wall second, last window
+};
+
+// Fixed-timestep clock for one Chip8. Emulated time is instructions / ips;
+// the delay and sound timers tick each time it crosses a multiple of
+// 1/TIMER_HZ, at that exact instruction, however often the caller wakes.
+// Time spent blocked on FX0A still passes, so timers keep counting while
+// the program waits for a key.
+struct Scheduler {
+    uint32_t ips = DEFAULT_IPS;
+    uint64_t instructions = 0;      // emulated clock
+    uint64_t timerTicks = 0;
+    SchedClock::time_point start;   // wall time at emulated time 0
+
+    SchedClock::time_point window;  // timerHz measurement
+    uint64_t windowTicks = 0;
+    SchedulerStats stats;
+};
+
+// Starts emulated time at now. Also used to change ips.
+void resetScheduler(Scheduler &s, uint32_t ips, SchedClock::time_point now);
+
+// Runs every instruction due by now, ticking timers on the way. Returns
+// the number of instructions executed.
+uint64_t runUntil(Scheduler &s, Chip8 &c, Core &core, SchedClock::time_point now);
+
+// Runs up to the instruction due at wall time t, without touching the
+// stats. For delivering an event at the instruction matching when it
+// happened; does nothing if emulated time is already past t.
+uint64_t runTo(Scheduler &s, Chip8 &c, Core &core, SchedClock::time_point t);
+
+// Runs n instructions as fast as the host allows. Timers still tick by
+// emulated time, so a program sees the same timer values it would at
+// ips; only the wall clock is ignored. timerHz then reads as emulated
+// frames per wall second. Returns the number of instructions executed.
+uint64_t runTurbo(Scheduler &s, Chip8 &c, Core &core, uint64_t n);
+
+// Wall time of the next timer tick, a natural time to wake up again.
+SchedClock::time_point nextTimerTick(const Scheduler &s);
+
+
+#endif
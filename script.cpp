@@ -0,0 +1,90 @@
+#include "script.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+
+static bool parseKey(const std::string &arg, bool down, bool tap, std::vector<ScriptedKey> &script) {
+    long frame, hold = 1;
+    unsigned key;
+    // %n after each optional field: the whole argument must be consumed
+    int used = 0;
+    int fields = std::sscanf(arg.c_str(), "%ld:%x%n:%ld%n", &frame, &key, &used, &hold, &used);
+    bool whole = used > 0 && static_cast<size_t>(used) == arg.size();
+    if (fields < 2 || !whole || (fields == 3 && !tap) || frame < 0 || key >= NUM_KEYS || hold < 1) {
+        std::cerr << "Bad key script: " << arg << "\n";
+        return false;
+    }
+    script.push_back({ frame, static_cast<int>(key), down });
+    if (tap)
+        script.push_back({ frame + hold, static_cast<int>(key), false });
+    return true;
+}
+
+
+bool parseRunOption(const std::vector<std::string> &args, size_t &i, RunSpec &spec) {
+    const std::string &arg = args[i];
+    if (i + 1 >= args.size())
+        return false;
+    const char *value = args[i + 1].c_str();
+
+    if (arg == "--frames")
+        spec.frames = std::atol(value);
+    else if (arg == "--instructions")
+        spec.instructions = std::atol(value);
+    else if (arg == "--cycles")
+        spec.cyclesPerFrame = static_cast<uint32_t>(std::max(1l, std::atol(value)));
+    else if (arg == "--seed")
+        spec.seed = static_cast<unsigned>(std::atol(value));
+    else if (arg == "--press" || arg == "--release" || arg == "--tap") {
+        if (!parseKey(value, arg != "--release", arg == "--tap", spec.script))
+            return false;
+    } else
+        return false;
+    ++i;
+    return true;
+}
+
+
+void finishRunSpec(RunSpec &spec) {
+    if (spec.instructions >= 0)
+        spec.frames = (spec.instructions + spec.cyclesPerFrame - 1) / spec.cyclesPerFrame;
+    else
+        spec.instructions = spec.frames * spec.cyclesPerFrame;
+
+    std::stable_sort(spec.script.begin(), spec.script.end(),
+                     [](const ScriptedKey &a, const ScriptedKey &b) { return a.frame < b.frame; });
+}
+
+
+static void tickTimers(Chip8 &c) {
+    if (c.delayTimer > 0) --c.delayTimer;
+    if (c.soundTimer > 0) --c.soundTimer;
+}
+
+
+long runScripted(Chip8 &c, const RunSpec &spec,
+                 void (*onFrame)(const Chip8 &c, long executed, void *ctx), void *ctx) {
+    seedRandom(spec.seed);
+
+    size_t next = 0;
+    long elapsed = 0, executed = 0;
+    for (long f = 0; f < spec.frames; ++f) {
+        for (; next < spec.script.size() && spec.script[next].frame == f; ++next)
+            c.keys[spec.script[next].key] = spec.script[next].down;
+
+        // FX0A with no key down would only re-execute; the time still passes
+        long n = std::min<long>(spec.cyclesPerFrame, spec.instructions - elapsed);
+        long i = 0;
+        for (; i < n && !blockedOnKey(c); ++i)
+            emulateCycle(c);
+        elapsed += n;
+        executed += i;
+        tickTimers(c);
+        if (onFrame)
+            onFrame(c, executed, ctx);
+    }
+    return executed;
+}
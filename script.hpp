@@ -0,0 +1,49 @@
+#ifndef SCRIPT_HPP
+#define SCRIPT_HPP
+
+#include "cpu.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A scripted, display-less run: the options shared by chip8_headless and
+// the lines of a chip8_farm job list.
+//
+// Time is counted in 60 Hz frames of cyclesPerFrame instructions each (8
+// by default, as the SDL front end runs at 500 IPS). Scripted input names
+// the frame it applies at and a hex key: --press 120:5 holds key 5 from
+// frame 120, --release 180:5 lets go, --tap 120:5:3 does both 3 frames
+// apart. CXNN draws from the thread's random stream seeded with --seed,
+// so runs are reproducible.
+
+struct ScriptedKey {
+    long frame;
+    int key;
+    bool down;
+};
+
+struct RunSpec {
+    long frames = 600;
+    long instructions = -1;          // run time in instructions, overrides frames when set
+    uint32_t cyclesPerFrame = 8;
+    unsigned seed = 1;
+    std::vector<ScriptedKey> script;
+};
+
+// Applies the option at args[i], moving i past its value. Returns false
+// for an option it does not know or a malformed value.
+bool parseRunOption(const std::vector<std::string> &args, size_t &i, RunSpec &spec);
+
+// Settles frames against instructions and orders the script by frame.
+void finishRunSpec(RunSpec &spec);
+
+// Runs a loaded machine through spec on the calling thread and returns
+// the instructions executed, which is fewer than spec.instructions when
+// the program waits on FX0A. onFrame, if set, is called at the end of
+// every frame, after the timers tick, with the count so far.
+long runScripted(Chip8 &c, const RunSpec &spec,
+                 void (*onFrame)(const Chip8 &c, long executed, void *ctx) = nullptr, void *ctx = nullptr);
+
+
+#endif
@@ -0,0 +1,224 @@
+#include "shmring.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static std::string shmName(const std::string &name) {
+    return name.starts_with('/') ? name : "/" + name;
+}
+
+
+static size_t ringBytes(uint32_t slots) {
+    return sizeof(RingHeader) + size_t{slots} * sizeof(RingSlot);
+}
+
+
+bool openRingWriter(RingWriter &w, const std::string &name, uint32_t slots, bool replace) {
+    if (w.header) {
+        std::cerr << "Already exporting to " << w.name << "\n";
+        return false;
+    }
+    slots = std::bit_ceil(std::max(slots, 2u));
+    w.name = shmName(name);
+    w.bytes = ringBytes(slots);
+
+    // Always a fresh object, so readers still mapping an old ring never
+    // see this one being initialised under them
+    if (replace)
+        shm_unlink(w.name.c_str());
+    int fd = shm_open(w.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        if (errno == EEXIST)
+            std::cerr << w.name << " already exists; another writer may be using it (replace it to take over)\n";
+        else
+            std::cerr << "shm_open " << w.name << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(w.bytes)) != 0) {
+        std::cerr << "ftruncate " << w.name << ": " << std::strerror(errno) << "\n";
+        close(fd);
+        shm_unlink(w.name.c_str());
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        w.device = st.st_dev;
+        w.inode = st.st_ino;
+    }
+    void *p = mmap(nullptr, w.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "mmap " << w.name << ": " << std::strerror(errno) << "\n";
+        shm_unlink(w.name.c_str());
+        return false;
+    }
+
+    // The new object is zero-filled, so every slot's seq already reads as
+    // "nothing written"
+    w.header = static_cast<RingHeader *>(p);
+    w.slots = reinterpret_cast<RingSlot *>(static_cast<char *>(p) + sizeof(RingHeader));
+    w.next = 0;
+    w.header->slots = slots;
+    w.header->slotSize = sizeof(RingSlot);
+    w.header->version = RING_VERSION;
+    w.header->published.store(0, std::memory_order_relaxed);
+    w.header->closed.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    w.header->magic = RING_MAGIC;
+    return true;
+}
+
+
+void closeRingWriter(RingWriter &w) {
+    if (!w.header)
+        return;
+    w.header->closed.store(1, std::memory_order_release);
+    munmap(w.header, w.bytes);
+
+    int fd = shm_open(w.name.c_str(), O_RDONLY, 0);
+    if (fd >= 0) {
+        struct stat st;
+        bool ours = fstat(fd, &st) == 0 && st.st_dev == w.device && st.st_ino == w.inode;
+        close(fd);
+        if (ours)
+            shm_unlink(w.name.c_str());
+    }
+    w.header = nullptr;
+    w.slots = nullptr;
+}
+
+
+void exportFrame(RingWriter &w, const Chip8 &c, uint64_t instructions) {
+    const uint64_t n = w.next++;
+    RingSlot &s = w.slots[n & (w.header->slots - 1)];
+
+    s.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ExportedFrame &f = s.frame;
+    f.frame = n;
+    f.instructions = instructions;
+    std::memcpy(f.gfx, c.gfx, sizeof(f.gfx));
+    std::memcpy(f.stack, c.stack, sizeof(f.stack));
+    std::memcpy(f.V, c.V, sizeof(f.V));
+    f.I = c.I;
+    f.pc = c.pc;
+    f.opcode = c.opcode;
+    uint16_t keys = 0;
+    for (int k = 0; k < NUM_KEYS; ++k)
+        keys |= static_cast<uint16_t>(c.keys[k]) << k;
+    f.keys = keys;
+    f.sp = c.sp;
+    f.delayTimer = c.delayTimer;
+    f.soundTimer = c.soundTimer;
+    f.key_wait = c.key_wait;
+
+    s.seq.store(2 * n + 2, std::memory_order_release);
+    w.header->published.store(n + 1, std::memory_order_release);
+}
+
+
+bool openRingReader(RingReader &r, const std::string &name) {
+    std::string path = shmName(name);
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "shm_open " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RingHeader)) {
+        std::cerr << path << " is not a frame ring\n";
+        close(fd);
+        return false;
+    }
+    r.bytes = static_cast<size_t>(st.st_size);
+    void *p = mmap(nullptr, r.bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "mmap " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    r.header = static_cast<const RingHeader *>(p);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (r.header->magic != RING_MAGIC || r.header->version != RING_VERSION ||
+        r.header->slotSize != sizeof(RingSlot) || r.bytes < ringBytes(r.header->slots)) {
+        std::cerr << path << " is not a version " << RING_VERSION << " frame ring\n";
+        closeRingReader(r);
+        return false;
+    }
+    r.slots = reinterpret_cast<const RingSlot *>(static_cast<const char *>(p) + sizeof(RingHeader));
+
+    uint64_t published = framesPublished(r);
+    r.next = published > r.header->slots ? published - r.header->slots : 0;
+    r.dropped = 0;
+    return true;
+}
+
+
+void closeRingReader(RingReader &r) {
+    if (!r.header)
+        return;
+    munmap(const_cast<RingHeader *>(r.header), r.bytes);
+    r.header = nullptr;
+    r.slots = nullptr;
+}
+
+
+uint64_t framesPublished(const RingReader &r) {
+    return r.header->published.load(std::memory_order_acquire);
+}
+
+
+bool writerClosed(const RingReader &r) {
+    return r.header->closed.load(std::memory_order_acquire) != 0;
+}
+
+
+void skipToLatest(RingReader &r) {
+    uint64_t published = framesPublished(r);
+    if (published > r.next + 1) {
+        r.dropped += published - 1 - r.next;
+        r.next = published - 1;
+    }
+}
+
+
+const ExportedFrame *beginRead(RingReader &r) {
+    const uint64_t slots = r.header->slots;
+    for (;;) {
+        uint64_t published = framesPublished(r);
+        if (r.next >= published)
+            return nullptr;
+        if (published - r.next > slots) {
+            r.dropped += published - slots - r.next;
+            r.next = published - slots;
+        }
+        const RingSlot &s = r.slots[r.next & (slots - 1)];
+        if (s.seq.load(std::memory_order_acquire) == 2 * r.next + 2)
+            return &s.frame;
+        // Already being overwritten by a later frame
+        ++r.dropped;
+        ++r.next;
+    }
+}
+
+
+bool endRead(RingReader &r) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const RingSlot &s = r.slots[r.next & (r.header->slots - 1)];
+    bool intact = s.seq.load(std::memory_order_relaxed) == 2 * r.next + 2;
+    if (!intact)
+        ++r.dropped;
+    ++r.next;
+    return intact;
+}
@@ -0,0 +1,112 @@
+#ifndef SHMRING_HPP
+#define SHMRING_HPP
+
+#include "cpu.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Publishes frames to other processes through a POSIX shared-memory ring
+// (shm_open, so /dev/shm/<name> on Linux). One writer, any number of
+// readers, and the writer never waits for any of them: frame n goes to
+// slot n % slots whether or not it has been read.
+//
+// Each slot is a seqlock. The writer sets the slot's seq to 2n + 1,
+// writes the frame, then sets it to 2n + 2 and bumps published. A reader
+// looks at a slot in place, with no copy, and checks afterwards that seq
+// is still 2n + 2. If the writer lapped it meanwhile, the reader drops
+// that frame and skips ahead.
+
+constexpr uint32_t RING_MAGIC = 0x38504843;    // "CHP8"
+constexpr uint32_t RING_VERSION = 1;
+
+// What is exported after each frame: the screen and the registers
+struct ExportedFrame {
+    uint64_t frame;                  // sequence number, from 0
+    uint64_t instructions;           // executed since start
+    uint64_t gfx[SCREEN_HEIGHT];     // Chip8::gfx rows
+    uint16_t stack[STACK_SIZE];
+    uint8_t V[NUM_REGISTERS];
+    uint16_t I;
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t keys;                   // bit k set while key k is held
+    uint8_t sp;
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+    uint8_t key_wait;
+};
+
+struct alignas(64) RingSlot {
+    std::atomic<uint64_t> seq;       // 2n + 1 while frame n is written, 2n + 2 after
+    ExportedFrame frame;
+};
+
+struct alignas(64) RingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;                  // a power of two
+    uint32_t slotSize;               // sizeof(RingSlot), to catch layout mismatches
+    alignas(64) std::atomic<uint64_t> published;   // frames written so far
+    std::atomic<uint32_t> closed;                  // set when the writer is done
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock-free");
+
+struct RingWriter {
+    std::string name;
+    RingHeader *header = nullptr;
+    RingSlot *slots = nullptr;
+    size_t bytes = 0;
+    uint64_t device = 0;             // identify our object, so closing after a
+    uint64_t inode = 0;              // replace does not unlink the new ring
+    uint64_t next = 0;
+};
+
+struct RingReader {
+    const RingHeader *header = nullptr;
+    const RingSlot *slots = nullptr;
+    size_t bytes = 0;
+    uint64_t next = 0;               // next frame to read
+    uint64_t dropped = 0;            // frames overwritten before they were read
+};
+
+// Creates the ring /name with slots slots, rounded up to a power of two.
+// Fails if /name already exists, as it may belong to a live writer, unless
+// replace is set: then the old object is unlinked first and its readers
+// keep the old ring. Returns false with a message on stderr on failure.
+bool openRingWriter(RingWriter &w, const std::string &name, uint32_t slots, bool replace = false);
+
+// Marks the ring closed, then unmaps it and unlinks the name if it still
+// refers to this ring; attached readers keep their mapping and can drain
+// what is left.
+void closeRingWriter(RingWriter &w);
+
+// Copies c into the next slot and publishes it.
+void exportFrame(RingWriter &w, const Chip8 &c, uint64_t instructions);
+
+// Attaches to an existing ring, starting at the oldest frame still in it.
+bool openRingReader(RingReader &r, const std::string &name);
+void closeRingReader(RingReader &r);
+
+uint64_t framesPublished(const RingReader &r);
+bool writerClosed(const RingReader &r);
+
+// Moves next to the newest published frame, counting the ones skipped as
+// dropped; for readers that only want the current state.
+void skipToLatest(RingReader &r);
+
+// Returns the slot holding frame r.next, or nullptr if it has not been
+// published yet. The frame is read in place and is only valid if
+// endRead returns true afterwards.
+const ExportedFrame *beginRead(RingReader &r);
+
+// Returns false if the writer overwrote the frame while it was being
+// read, in which case whatever was read from it must be discarded.
+// Moves on to the next frame either way.
+bool endRead(RingReader &r);
+
+
+#endif
@@ -0,0 +1,85 @@
+#include "cpu.hpp"
+#include "decode.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+
+// One handler per opcode, generated at compile time. Each handler is
+// execute<Op> instantiated with x and y as template arguments, so register
+// indices are constants; only nn/nnn/n are taken from the opcode at run
+// time. Handlers that ignore y (or x) share one instantiation.
+
+using OpcodeHandler = void (*)(Chip8 &);
+
+constexpr bool usesX(Op op) {
+    switch (op) {
+        case Op::NOP: case Op::CLS: case Op::RET: case Op::JP: case Op::CALL:
+        case Op::LD_I: case Op::JP_V0:
+            return false;
+        default:
+            return true;
+    }
+}
+
+constexpr bool usesY(Op op) {
+    switch (op) {
+        case Op::SE_VX_VY: case Op::SNE_VX_VY: case Op::LD_VX_VY:
+        case Op::OR: case Op::AND: case Op::XOR:
+        case Op::ADD_VX_VY: case Op::SUB: case Op::SUBN: case Op::DRW:
+            return true;
+        default:
+            return false;
+    }
+}
+
+template <Op O, uint8_t X, uint8_t Y>
+static void specializedHandler(Chip8 &c) {
+    const Instr d{ O, X, Y,
+                   static_cast<uint8_t>(c.opcode & 0x000F),
+                   static_cast<uint16_t>(c.opcode & 0x0FFF),
+                   c.opcode };
+    execute<O>(c, d);
+}
+
+// The 256 x/y variants of one handler, indexed by (x << 4) | y
+template <Op O, size_t... XY>
+constexpr std::array<OpcodeHandler, 256> variants(std::index_sequence<XY...>) {
+    return { &specializedHandler<O,
+                                 usesX(O) ? static_cast<uint8_t>(XY >> 4) : uint8_t{0},
+                                 usesY(O) ? static_cast<uint8_t>(XY & 0xF) : uint8_t{0}>... };
+}
+
+static constexpr std::array<std::array<OpcodeHandler, 256>, NUM_OPS> VARIANTS = {
+#define CHIP8_OP_VARIANTS(name) variants<Op::name>(std::make_index_sequence<256>{}),
+    CHIP8_OPS(CHIP8_OP_VARIANTS)
+#undef CHIP8_OP_VARIANTS
+};
+
+static constexpr std::array<OpcodeHandler, 65536> OPCODE_HANDLERS = [] {
+    std::array<OpcodeHandler, 65536> table{};
+    for (size_t opcode = 0; opcode < table.size(); ++opcode) {
+        Op op = decodeOp(static_cast<uint16_t>(opcode));
+        table[opcode] = VARIANTS[static_cast<size_t>(op)][(opcode >> 4) & 0xFF];
+    }
+    return table;
+}();
+
+
+void emulateCycleSpecialized(Chip8 &c) {
+    c.opcode = readOpcode(c, c.pc);
+    OPCODE_HANDLERS[c.opcode](c);
+}
+
+
+uint32_t runSpecialized(Chip8 &c, uint32_t budget) {
+    for (uint32_t i = 0; i < budget; ++i) {
+        c.opcode = readOpcode(c, c.pc);
+        OPCODE_HANDLERS[c.opcode](c);
+        if (c.key_wait)
+            return i + 1;
+    }
+    return budget;
+}
@@ -0,0 +1,282 @@
+#define GL_GLEXT_PROTOTYPES
+#include "texture.hpp"
+#include "expand.hpp"
+
+#include <GL/glext.h>
+
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+
+
+constexpr int ROW_BYTES = SCREEN_WIDTH * 4;    // widest format; sizes the PBOs
+
+// Plane bits -> palette entry. Index textures are normalized R8, so the
+// stored byte is recovered by scaling back up before the lookup.
+static const char *PALETTE_VS =
+    "#version 130\n"
+    "out vec2 uv;\n"
+    "void main() {\n"
+    "    vec2 p = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+    "    uv = p;\n"
+    "    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *PALETTE_FS =
+    "#version 130\n"
+    "uniform sampler2D planes;\n"
+    "uniform vec4 palette[16];\n"
+    "in vec2 uv;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "    int i = int(texture(planes, uv).r * 255.0 + 0.5);\n"
+    "    color = palette[i & 15];\n"
+    "}\n";
+
+
+const char *uploadModeName(UploadMode mode) {
+    switch (mode) {
+        case UploadMode::Sync: return "sync";
+        case UploadMode::Pbo:  return "pbo";
+        default:               return "?";
+    }
+}
+
+
+const char *textureFormatName(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::RGBA:    return "rgba";
+        case TextureFormat::Indexed: return "indexed";
+        default:                     return "?";
+    }
+}
+
+
+static GLuint compileShader(GLenum type, const char *src) {
+    GLuint s = glCreateShader(type);
+    glShaderSource(s, 1, &src, nullptr);
+    glCompileShader(s);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[512];
+        glGetShaderInfoLog(s, sizeof(log), nullptr, log);
+        fprintf(stderr, "Palette shader failed to compile: %s\n", log);
+    }
+    return s;
+}
+
+
+// Returns 0 if the program does not link; the Indexed format is then
+// unavailable and uploads fall back to RGBA.
+static GLuint linkPaletteProgram() {
+    GLuint vs = compileShader(GL_VERTEX_SHADER, PALETTE_VS);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, PALETTE_FS);
+    GLuint p = glCreateProgram();
+    glAttachShader(p, vs);
+    glAttachShader(p, fs);
+    glBindFragDataLocation(p, 0, "color");
+    glLinkProgram(p);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(p, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[512];
+        glGetProgramInfoLog(p, sizeof(log), nullptr, log);
+        fprintf(stderr, "Palette shader failed to link: %s\n", log);
+        glDeleteProgram(p);
+        return 0;
+    }
+    return p;
+}
+
+
+static GLuint createScreenTexture(GLint internalFormat, GLenum format) {
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat,
+                 SCREEN_WIDTH, SCREEN_HEIGHT,
+                 0, format, GL_UNSIGNED_BYTE, nullptr);
+    return tex;
+}
+
+
+void createDisplayTexture(DisplayTexture &t) {
+    t.tex = createScreenTexture(GL_RGBA, GL_RGBA);
+    t.planes = createScreenTexture(GL_R8, GL_RED);
+
+    glGenBuffers(2, t.pbo);
+    for (GLuint pbo : t.pbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, ROW_BYTES * SCREEN_HEIGHT, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    t.nextPbo = 0;
+
+    glGenFramebuffers(1, &t.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, t.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, t.tex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glGenVertexArrays(1, &t.vao);
+
+    t.program = linkPaletteProgram();
+    if (t.program) {
+        glUseProgram(t.program);
+        glUniform1i(glGetUniformLocation(t.program, "planes"), 0);
+        t.paletteLoc = glGetUniformLocation(t.program, "palette");
+        glUseProgram(0);
+    } else {
+        t.format = TextureFormat::RGBA;
+    }
+    t.repaint = true;
+}
+
+
+void destroyDisplayTexture(DisplayTexture &t) {
+    glDeleteProgram(t.program);
+    glDeleteVertexArrays(1, &t.vao);
+    glDeleteFramebuffers(1, &t.fbo);
+    glDeleteBuffers(2, t.pbo);
+    glDeleteTextures(1, &t.planes);
+    glDeleteTextures(1, &t.tex);
+    t = DisplayTexture{};
+}
+
+
+void setTextureFormat(DisplayTexture &t, TextureFormat format) {
+    if (format == TextureFormat::Indexed && !t.program)
+        return;
+    t.format = format;
+    t.repaint = true;
+}
+
+
+void setPaletteColor(DisplayTexture &t, int index, uint32_t rgba) {
+    t.palette[index] = rgba;
+    t.repaint = true;
+}
+
+
+// Calls f(first, count) for each contiguous run of set bits in rows
+template <typename F>
+static void forEachRun(uint32_t rows, F f) {
+    while (rows) {
+        int first = std::countr_zero(rows);
+        int count = std::countr_one(rows >> first);
+        f(first, count);
+        rows &= count == 32 ? 0 : ~(((uint32_t{1} << count) - 1) << first);
+    }
+}
+
+
+// Expands count rows into out, which points at row first of a screen-sized
+// buffer in the current format.
+static void expandRows(const DisplayTexture &t, const Chip8 &c, int first, int count, void *out) {
+    if (t.format == TextureFormat::Indexed)
+        expandGray(c.gfx + first, count, static_cast<uint8_t *>(out), 1, 0);
+    else
+        expandRGBA(c.gfx + first, count, static_cast<uint32_t *>(out), t.palette[1], t.palette[0]);
+}
+
+
+static int rowBytes(const DisplayTexture &t) {
+    return t.format == TextureFormat::Indexed ? SCREEN_WIDTH : ROW_BYTES;
+}
+
+
+static GLenum pixelFormat(const DisplayTexture &t) {
+    return t.format == TextureFormat::Indexed ? GL_RED : GL_RGBA;
+}
+
+
+static void uploadSync(DisplayTexture &t, Chip8 &c, uint32_t rows) {
+    static uint32_t pixels[SCREEN_HEIGHT * SCREEN_WIDTH];
+    forEachRun(rows, [&](int first, int count) {
+        expandRows(t, c, first, count, pixels);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, SCREEN_WIDTH, count,
+                        pixelFormat(t), GL_UNSIGNED_BYTE, pixels);
+    });
+}
+
+
+// Invalidating the whole buffer on map lets the driver hand back fresh
+// memory instead of waiting on the upload that last read it. Rows keep
+// their screen offset inside the buffer, so each run uploads from there.
+static bool uploadPbo(DisplayTexture &t, Chip8 &c, uint32_t rows) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, t.pbo[t.nextPbo]);
+    t.nextPbo ^= 1;
+
+    auto *mapped = static_cast<uint8_t *>(glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, ROW_BYTES * SCREEN_HEIGHT,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (!mapped) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+    int stride = rowBytes(t);
+    forEachRun(rows, [&](int first, int count) {
+        expandRows(t, c, first, count, mapped + first * stride);
+    });
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    forEachRun(rows, [&](int first, int count) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, SCREEN_WIDTH, count,
+                        pixelFormat(t), GL_UNSIGNED_BYTE,
+                        reinterpret_cast<const void *>(static_cast<uintptr_t>(first * stride)));
+    });
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return true;
+}
+
+
+// Draws the plane texture through the palette into tex. Only the state
+// the UI renderer does not reset itself is saved and restored.
+static void resolvePalette(const DisplayTexture &t) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    float palette[PALETTE_SIZE][4];
+    for (int i = 0; i < PALETTE_SIZE; ++i)
+        for (int ch = 0; ch < 4; ++ch)
+            palette[i][ch] = ((t.palette[i] >> (8 * ch)) & 0xFF) / 255.0f;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, t.fbo);
+    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glUseProgram(t.program);
+    glUniform4fv(t.paletteLoc, PALETTE_SIZE, &palette[0][0]);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, t.planes);
+    glBindVertexArray(t.vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+
+void uploadDisplay(DisplayTexture &t, Chip8 &c) {
+    uint32_t rows = c.dirty_rows;
+    c.dirty_rows = 0;
+    if (t.repaint) {
+        rows = ~uint32_t{0};
+        t.repaint = false;
+    }
+    if (!rows)
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, t.format == TextureFormat::Indexed ? t.planes : t.tex);
+    if (t.mode != UploadMode::Pbo || !uploadPbo(t, c, rows))
+        uploadSync(t, c, rows);
+
+    if (t.format == TextureFormat::Indexed)
+        resolvePalette(t);
+}
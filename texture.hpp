@@ -0,0 +1,65 @@
+#ifndef TEXTURE_HPP
+#define TEXTURE_HPP
+
+#include "cpu.hpp"
+
+#include <GL/gl.h>
+
+#include <cstdint>
+
+// Entries in the display palette. A pixel's index is its plane bits, so a
+// one-plane CHIP-8 screen uses 0 and 1 and a four-plane one would use all 16.
+constexpr int PALETTE_SIZE = 16;
+
+// How framebuffer rows reach the display texture.
+enum class UploadMode : uint8_t {
+    Sync,    // glTexSubImage2D from client memory; the driver copies before returning
+    Pbo,     // expand into one of two mapped pixel buffer objects, upload from it
+    COUNT
+};
+
+// What is uploaded per pixel.
+enum class TextureFormat : uint8_t {
+    RGBA,      // 4 bytes, palette applied on the CPU while expanding
+    Indexed,   // 1 byte of plane bits, palette applied by a shader pass
+    COUNT
+};
+
+const char *uploadModeName(UploadMode mode);
+const char *textureFormatName(TextureFormat format);
+
+// The 64x32 RGBA display texture the UI draws, plus what feeds it: two
+// streaming PBOs, and for the Indexed format an R8 plane texture that a
+// palette shader renders into tex. Storage is allocated once; each upload
+// only sends the rows in Chip8::dirty_rows.
+// In Pbo mode the rows are written straight into a mapped buffer while the
+// other buffer's previous upload may still be in flight, so the CPU never
+// waits for the driver to finish reading it.
+struct DisplayTexture {
+    GLuint tex = 0;
+    GLuint pbo[2] = {};
+    int nextPbo = 0;
+    UploadMode mode = UploadMode::Pbo;
+
+    TextureFormat format = TextureFormat::RGBA;
+    GLuint planes = 0;        // R8 plane bits (Indexed)
+    GLuint fbo = 0;           // renders the palette pass into tex
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLint paletteLoc = -1;
+    uint32_t palette[PALETTE_SIZE] = { 0xFF000000, 0xFFFFFFFF };   // RGBA bytes, R lowest
+    bool repaint = true;      // palette or format changed: redo every row
+};
+
+// Needs a current GL 3.0+ context.
+void createDisplayTexture(DisplayTexture &t);
+void destroyDisplayTexture(DisplayTexture &t);
+
+void setTextureFormat(DisplayTexture &t, TextureFormat format);
+void setPaletteColor(DisplayTexture &t, int index, uint32_t rgba);
+
+// Uploads the rows changed since the last call and clears dirty_rows.
+void uploadDisplay(DisplayTexture &t, Chip8 &c);
+
+
+#endif
@@ -0,0 +1,180 @@
+#define GL_GLEXT_PROTOTYPES
+#include "cpu.hpp"
+#include "engine.hpp"
+#include "expand.hpp"
+#include "texture.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/glext.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+
+// Display upload benchmark on a headless EGL context, so it runs on
+// machines without a GPU or X server through Mesa's llvmpipe. Each frame
+// runs the ROM, uploads the changed rows and blits the texture 10x into an
+// offscreen framebuffer the way the debugger window draws it. Reports the
+// average frame and upload time for every UploadMode and TextureFormat and
+// checks that the texture ends up holding the framebuffer in the palette's
+// colors, so both formats are shown to look the same.
+//
+//   ./upload_bench [--frames N] [--full] [rom]
+//
+// --full marks every row dirty each frame (worst case for the upload).
+
+constexpr int SCALE = 10;
+constexpr uint32_t OFF_COLOR = 0xFF102040;   // not black and white, so the
+constexpr uint32_t ON_COLOR = 0xFF40C0F0;    // palette is seen to apply
+
+static Core core;
+
+
+static bool createContext() {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    EGLDisplay dpy = getPlatformDisplay
+        ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+        : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, nullptr, nullptr) ||
+        !eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    eglChooseConfig(dpy, configAttribs, &config, 1, &numConfigs);
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 0, EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(dpy, numConfigs ? config : nullptr,
+                                      EGL_NO_CONTEXT, contextAttribs);
+    return ctx != EGL_NO_CONTEXT &&
+           eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx);
+}
+
+
+static bool textureMatches(const DisplayTexture &t, const Chip8 &c) {
+    static uint32_t expected[SCREEN_HEIGHT * SCREEN_WIDTH], actual[SCREEN_HEIGHT * SCREEN_WIDTH];
+    expandRGBA(c.gfx, SCREEN_HEIGHT, expected, t.palette[1], t.palette[0]);
+    glBindTexture(GL_TEXTURE_2D, t.tex);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, actual);
+    return std::memcmp(expected, actual, sizeof(actual)) == 0;
+}
+
+
+static bool benchMode(UploadMode mode, TextureFormat format,
+                      const std::string &rom, long frames, bool full) {
+    Chip8 chip8;
+    initialise(chip8);
+    if (!loadROM(rom, chip8))
+        std::exit(1);
+    seedRandom(1);
+    selectEngine(core, Engine::Cycles);
+
+    DisplayTexture display;
+    display.mode = mode;
+    createDisplayTexture(display);
+    setTextureFormat(display, format);
+    setPaletteColor(display, 0, OFF_COLOR);
+    setPaletteColor(display, 1, ON_COLOR);
+    if (display.format != format) {
+        std::cout << "  " << textureFormatName(format) << ": unsupported by this context\n";
+        destroyDisplayTexture(display);
+        return false;
+    }
+
+    GLuint fbo[2], target;
+    glGenFramebuffers(2, fbo);
+    glGenRenderbuffers(1, &target);
+    glBindRenderbuffer(GL_RENDERBUFFER, target);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCREEN_WIDTH * SCALE, SCREEN_HEIGHT * SCALE);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo[0]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, display.tex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo[1]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target);
+
+    using Clock = std::chrono::steady_clock;
+    double uploadNs = 0.0;
+    long uploads = 0;
+    glFinish();
+    auto start = Clock::now();
+    for (long f = 0; f < frames; ++f) {
+        runCore(chip8, core, 8);
+        if (chip8.delayTimer > 0) --chip8.delayTimer;
+        if (chip8.soundTimer > 0) --chip8.soundTimer;
+
+        if (full)
+            chip8.dirty_rows = ~uint32_t{0};
+        if (chip8.dirty_rows) {
+            auto t0 = Clock::now();
+            uploadDisplay(display, chip8);
+            uploadNs += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+            ++uploads;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo[1]);
+        glBlitFramebuffer(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT,
+                          0, 0, SCREEN_WIDTH * SCALE, SCREEN_HEIGHT * SCALE,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glFlush();
+    }
+    glFinish();
+    auto end = Clock::now();
+
+    double frameUs = std::chrono::duration<double, std::micro>(end - start).count() / frames;
+    std::cout << "  " << uploadModeName(mode) << "/" << textureFormatName(format)
+              << ": " << frameUs << " us/frame, "
+              << (uploads ? uploadNs / uploads / 1000.0 : 0.0) << " us/upload ("
+              << uploads << " uploads)\n";
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    bool ok = textureMatches(display, chip8);
+    glDeleteFramebuffers(2, fbo);
+    glDeleteRenderbuffers(1, &target);
+    destroyDisplayTexture(display);
+    return ok;
+}
+
+
+int main(int argc, char **argv) {
+    long frames = 5'000;
+    bool full = false;
+    std::string rom = "Particle Demo [zeroZshadow, 2008].ch8";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+            frames = std::atol(argv[++i]);
+        else if (arg == "--full")
+            full = true;
+        else
+            rom = arg;
+    }
+
+    if (!createContext()) {
+        std::cerr << "Failed to create a headless EGL OpenGL context\n";
+        return 1;
+    }
+    std::cout << rom << " on " << glGetString(GL_RENDERER) << "\n";
+
+    int status = 0;
+    for (int f = 0; f < static_cast<int>(TextureFormat::COUNT); ++f) {
+        for (int i = 0; i < static_cast<int>(UploadMode::COUNT); ++i) {
+            UploadMode mode = static_cast<UploadMode>(i);
+            TextureFormat format = static_cast<TextureFormat>(f);
+            if (!benchMode(mode, format, rom, frames, full)) {
+                std::cerr << uploadModeName(mode) << "/" << textureFormatName(format)
+                          << ": texture differs from the framebuffer\n";
+                status = 1;
+            }
+        }
+    }
+    return status;
+}